@@ -5,11 +5,14 @@
  *
  * スタックマシンの使用
  *
- * 全てのノードは必ず一つだけの要素が残るようにpushする
+ * gen()  値を使う場所の式。全てのノードは必ず一つだけの要素が残るようにpushする
+ * gen_stmt()  値を使わない文や式。スタックには何も残さない
  */
 
 static void gen(Node *node);
+static void gen_stmt(Node *node);
 static void load(Type *ty);
+static bool gen_lea(Node *node);
 
 static char *argreg64[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
 static char *argreg32[] = {"edi", "esi", "edx", "ecx", "r8d", "r9d"};
@@ -19,9 +22,29 @@ static char *argreg8[] = {"dil", "sil", "dl", "cl", "r8b", "r9b"};
 static char *raxreg[] = {"rax", "eax", "ax", "al"};   // size: 8, 4, 2, 1
 static char *rdireg[] = {"rdi", "edi", "di", "dil"};  // size: 8, 4, 2, 1
 static Function *current_fn;
+static Vector *code;  // 生成したアセンブリ (1行ずつ)
 
-// continue, breakに使う
+// プロローグの後に積んだ8バイトの値の個数 (レジスタにキャッシュした値も含む)
+// プロローグ直後のrspは16の倍数なので、実際に積んだ数が偶数なら関数を呼び出せる
+static int depth;
+static int max_depth;  // 関数内でのdepthの最大値
+
+// -fomit-frame-pointer: rbpの代わりにrspからの相対でローカル変数を参照する
+// frame_baseはdepthが0のときのrspから、rbpがあったはずの位置までの距離
+static int frame_base;
+static int frame_size;  // プロローグでrspから引く大きさ
+
+// continue, breakに使う (飛び先のループの番号+1、外にいるときは0)
+// switchはbreakの飛び先にだけなる
 int now_loop_count = 0;
+static int loop_depth = 0;  // ループ本体の先頭でのスタックの深さ
+static int continue_count = 0;
+static int continue_depth = 0;
+static int label_logical_count = 0;  // &&と||のラベル
+static int inline_depth = 0;         // インライン展開した本体の先頭でのスタックの深さ
+
+// これより大きい構造体のコピーはrep movsbで行う
+#define STRUCT_COPY_REP_THRESHOLD 128
 
 typedef enum RegKind {
     REG_RAX,
@@ -69,6 +92,20 @@ static int size_to_regindex(int size) {
     error("size_to_regindex() failure: [size=%d]サポートしてないレジスターのサイズです", size);
 }
 
+static char *word_ptr(int size) {
+    if (size == 8) {
+        return "QWORD";
+    } else if (size == 4) {
+        return "DWORD";
+    } else if (size == 2) {
+        return "WORD";
+    } else if (size == 1) {
+        return "BYTE";
+    }
+
+    error("word_ptr() failure: [size=%d]サポートしてないサイズです", size);
+}
+
 static char *proper_register(Type *ty, RegKind kind) {
     int size = ty->size;
     if (ty->kind == TYPE_ARRAY) {
@@ -88,108 +125,2272 @@ static char *proper_register(Type *ty, RegKind kind) {
     error("サポートしていないレジスターです");
 }
 
+/*
+ * スタックの先頭のキャッシュ (-O1以上)
+ *
+ * スタックマシンの先頭の値 (最大でCACHE_MAX個) は実際にはpushせずに
+ * 空いているr10, r11に置いておく。pushとpopはこのキャッシュの状態を変えるだけで、
+ * 実際にpush, popするのはあふれたときとキャッシュにない値を下ろすときだけになる。
+ *
+ * 積んだ値はすぐにはキャッシュのレジスタに移さず、元のレジスタか即値を覚えておく。
+ * 即値はpopかスタックに書き出すときまで、レジスタの値は次の命令を出力するまで移すのを遅らせる。
+ * 積んですぐに下ろすなら、キャッシュのレジスタを通さずに下ろす先へ直接movする。
+ *
+ * 分岐の前後で状態を揃えるために、文の先頭と式の中の分岐 (条件演算子、&&、||) の前後では
+ * flush_cache()でキャッシュを全てスタックに書き出す。文の中ではpushとpopの数が揃うので、
+ * ラベルとジャンプの位置ではキャッシュは空になる。
+ * r10, r11は関数呼び出しで壊れるので、引数を計算する前にも書き出す。
+ * depthはキャッシュも含めた論理的な深さで、実際にスタックに積んだ数はphys_depth()になる。
+ */
+
+#define CACHE_MAX 2
+
+typedef struct CacheEntry CacheEntry;
+
+struct CacheEntry {
+    char *reg;    // 値を置くレジスタ
+    char *src;    // まだregに移していない値のレジスタ (移した後はNULL)
+    bool is_num;  // 値が即値numのままになっている
+    long num;
+};
+
+static Vector *cache_regs;           // 現在の関数でキャッシュに使えるレジスタ
+static CacheEntry cache[CACHE_MAX];  // キャッシュした値 (0番が一番下)
+static int cached;                   // キャッシュした値の個数
+
+static bool is_imm32(long val);
+
+// まだレジスタに移していない値をキャッシュのレジスタに移す
+static void materialize_cache() {
+    for (int i = 0; i < cached; i++) {
+        if (cache[i].src) {
+            vec_push(code, format("  mov %s, %s", cache[i].reg, cache[i].src));
+            cache[i].src = NULL;
+        }
+    }
+}
+
+// 1行分のアセンブリを出力する
+static void emit(char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    char *line = vformat(fmt, ap);
+    va_end(ap);
+
+    // 改行は出力時に付ける
+    int len = strlen(line);
+    if (len > 0 && line[len - 1] == '\n') {
+        line[len - 1] = '\0';
+    }
+    // 積んだ値の元のレジスタはこの命令で書き換わるかもしれない
+    materialize_cache();
+    vec_push(code, line);
+}
+
+static int phys_depth() {
+    return depth - cached;
+}
+
+// キャッシュから外した値を実際にスタックに積む
+static void push_entry(CacheEntry *e) {
+    if (e->is_num && is_imm32(e->num)) {
+        emit("  push %ld\n", e->num);
+    } else if (e->is_num) {
+        emit("  mov %s, %ld\n", e->reg, e->num);
+        emit("  push %s\n", e->reg);
+    } else {
+        emit("  push %s\n", e->src ? e->src : e->reg);
+    }
+}
+
+// キャッシュの値を下から順に実際にスタックに積む
+static void flush_cache() {
+    CacheEntry entries[CACHE_MAX];
+    int n = cached;
+    for (int i = 0; i < n; i++) {
+        entries[i] = cache[i];
+    }
+    cached = 0;
+    for (int i = 0; i < n; i++) {
+        push_entry(&entries[i]);
+    }
+}
+
+static char *free_cache_reg() {
+    for (int i = 0; i < cache_regs->len; i++) {
+        char *reg = cache_regs->body[i];
+        bool used = false;
+        for (int j = 0; j < cached; j++) {
+            if (strcmp(cache[j].reg, reg) == 0) used = true;
+        }
+        if (!used) return reg;
+    }
+    return NULL;
+}
+
+// キャッシュに値を積む場所を空けて返す
+static CacheEntry *push_cache() {
+    char *reg = free_cache_reg();
+    if (reg == NULL) {
+        // 一番下のキャッシュをスタックに追い出す
+        CacheEntry bottom = cache[0];
+        for (int i = 1; i < cached; i++) {
+            cache[i - 1] = cache[i];
+        }
+        cached--;
+        push_entry(&bottom);
+        reg = bottom.reg;
+    }
+
+    CacheEntry *e = &cache[cached++];
+    e->reg = reg;
+    e->src = NULL;
+    e->is_num = false;
+    return e;
+}
+
+static bool use_cache() {
+    return cache_regs != NULL && cache_regs->len > 0;
+}
+
+static void push_reg(char *reg) {
+    depth++;
+    if (depth > max_depth) {
+        max_depth = depth;
+    }
+
+    if (!use_cache()) {
+        emit("  push %s\n", reg);
+        return;
+    }
+    push_cache()->src = reg;
+}
+
 static void push() {
-    printf("  push rax\n");
+    push_reg("rax");
 }
 
 static void push_rdi() {
-    printf("  push rdi\n");
+    push_reg("rdi");
+}
+
+static void push_num(long num) {
+    if (!use_cache()) {
+        emit("  mov rax, %ld\n", num);
+        push();
+        return;
+    }
+
+    depth++;
+    if (depth > max_depth) {
+        max_depth = depth;
+    }
+    CacheEntry *e = push_cache();
+    e->is_num = true;
+    e->num = num;
+}
+
+static void pop_reg(char *reg) {
+    depth--;
+    if (cached == 0) {
+        emit("  pop %s\n", reg);
+        return;
+    }
+
+    // 残りの値がregにあれば、書き換える前にemit()で移される
+    CacheEntry e = cache[--cached];
+    if (e.is_num) {
+        emit("  mov %s, %ld\n", reg, e.num);
+        return;
+    }
+    char *src = e.src ? e.src : e.reg;
+    if (strcmp(src, reg) != 0) {
+        emit("  mov %s, %s\n", reg, src);
+    }
+}
+
+static void pop() {
+    pop_reg("rax");
+}
+
+static void pop_rdi() {
+    pop_reg("rdi");
+}
+
+// 飛び先のスタックの深さまでrspを戻す (break, continue用)
+static void unwind_to(int to) {
+    flush_cache();
+    if (depth > to) {
+        emit("  add rsp, %d\n", (depth - to) * 8);
+    }
+}
+
+// rbpからoffsetの位置にあるスタック上の領域
+static char *frame_slot(int offset) {
+    if (!current_fn->omit_frame_pointer) {
+        return format("[rbp-%d]", offset);
+    }
+    int disp = frame_base + phys_depth() * 8 - offset;
+    return disp < 0 ? format("[rsp-%d]", -disp) : format("[rsp+%d]", disp);
+}
+
+/*
+ * ローカル変数のスタック上の配置
+ *
+ * 各変数は型の境界に揃えて置く。ブロックやforのスコープで宣言した変数は
+ * そのスコープの中でしか生きていないので、兄弟のスコープの変数と同じ領域を使い回す。
+ *
+ * {            // a
+ *     { b }    // b と c は同じ位置
+ *     { c }
+ * }
+ *
+ * 引数、インライン展開などで作った一時変数、
+ * 複数のスコープに現れる変数は関数全体で生きているものとして先に置く。
+ * レジスタに割り当てた変数には領域を取らない。
+ */
+static Vector *placed_vars;  // 位置を決めた変数
+static Vector *scoped_vars;  // スコープの中に置く変数
+
+static void place_var(Var *var, int *offset) {
+    if (var->reg || vec_contains(placed_vars, var)) return;
+    int align = alignOfType(var->type);
+    var->offset = (*offset + sizeOfType(var->type) + align - 1) / align * align;
+    *offset = var->offset;
+    vec_push(placed_vars, var);
+}
+
+static void collect_scoped_vars(Node *node, Vector *shared) {
+    if (node == NULL) return;
+    for (int i = 0; node->scope_vars && i < node->scope_vars->len; i++) {
+        Var *var = node->scope_vars->body[i];
+        if (!vec_union1(scoped_vars, var)) vec_union1(shared, var);
+    }
+    collect_scoped_vars(node->lhs, shared);
+    collect_scoped_vars(node->rhs, shared);
+    collect_scoped_vars(node->cond, shared);
+    collect_scoped_vars(node->then, shared);
+    collect_scoped_vars(node->els, shared);
+    collect_scoped_vars(node->body, shared);
+    collect_scoped_vars(node->init, shared);
+    collect_scoped_vars(node->inc, shared);
+    for (int i = 0; node->args && i < node->args->len; i++) collect_scoped_vars(node->args->body[i], shared);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) collect_scoped_vars(node->stmts->body[i], shared);
+}
+
+// スコープの分からない変数を関数全体の領域に置く
+static void place_unscoped_vars(Node *node, int *offset) {
+    if (node == NULL) return;
+    if (node->kind == ND_VAR && !node->var->is_global && !vec_contains(scoped_vars, node->var)) {
+        place_var(node->var, offset);
+    }
+    place_unscoped_vars(node->lhs, offset);
+    place_unscoped_vars(node->rhs, offset);
+    place_unscoped_vars(node->cond, offset);
+    place_unscoped_vars(node->then, offset);
+    place_unscoped_vars(node->els, offset);
+    place_unscoped_vars(node->body, offset);
+    place_unscoped_vars(node->init, offset);
+    place_unscoped_vars(node->inc, offset);
+    for (int i = 0; node->args && i < node->args->len; i++) place_unscoped_vars(node->args->body[i], offset);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) place_unscoped_vars(node->stmts->body[i], offset);
+}
+
+// offsetから先にスコープの変数を置き、使ったスタックの最大をmaxに入れる
+static void place_scoped_vars(Node *node, int offset, int *max) {
+    if (node == NULL) return;
+    // 宣言した順に置く
+    for (int i = node->scope_vars ? node->scope_vars->len - 1 : -1; i >= 0; i--) {
+        place_var(node->scope_vars->body[i], &offset);
+    }
+    if (*max < offset) *max = offset;
+
+    place_scoped_vars(node->lhs, offset, max);
+    place_scoped_vars(node->rhs, offset, max);
+    place_scoped_vars(node->cond, offset, max);
+    place_scoped_vars(node->then, offset, max);
+    place_scoped_vars(node->els, offset, max);
+    place_scoped_vars(node->body, offset, max);
+    place_scoped_vars(node->init, offset, max);
+    place_scoped_vars(node->inc, offset, max);
+    for (int i = 0; node->args && i < node->args->len; i++) place_scoped_vars(node->args->body[i], offset, max);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) place_scoped_vars(node->stmts->body[i], offset, max);
+}
+
+static void assign_lvar_offsets(Function *fn) {
+    placed_vars = new_vec();
+    scoped_vars = new_vec();
+    Vector *shared = new_vec();
+    collect_scoped_vars(fn->body, shared);
+
+    int offset = 0;
+    for (Var *param = fn->params; param; param = param->next) {
+        if (!param->lvar) continue;
+        // プロローグは引数のoffsetに書き込むのでローカル変数の位置と揃える
+        place_var(param->lvar, &offset);
+        param->offset = param->lvar->offset;
+    }
+    if (fn->va_area) place_var(fn->va_area, &offset);
+    for (int i = 0; i < shared->len; i++) place_var(shared->body[i], &offset);
+    place_unscoped_vars(fn->body, &offset);
+
+    int max = offset;
+    place_scoped_vars(fn->body, offset, &max);
+    fn->stack_size = max;
+}
+
+// 左辺値は変数である必要がある
+// ローカル変数のアドレスを生成
+static void gen_lval(Node *node) {
+    if (node->kind != ND_VAR) {
+        error("代入の左辺値が変数ではありません");
+    }
+
+    if (node->var->is_global) {
+        emit("  lea rax, [rip+%s]\n", node->var->name);
+    } else if (current_fn->omit_frame_pointer) {
+        emit("  lea rax, %s\n", frame_slot(node->var->offset));
+    } else {
+        emit("  mov rax, rbp\n");
+        emit("  sub rax, %d\n", node->var->offset);
+    }
+
+    push();
+}
+
+// ポインター変数への代入への対応
+static void gen_addr(Node *node) {
+    if ((node->kind == ND_DEREF || node->kind == ND_STRUCT_MEMBER) && gen_lea(node)) {
+        return;
+    } else if (node->kind == ND_DEREF) {
+        gen(node->lhs);
+        return;
+    } else if (node->kind == ND_VAR) {
+        if (node->var->reg) {
+            error("gen_addr() failure: レジスタに割り当てた変数%sのアドレスは取れません", node->var->name);
+        }
+        gen_lval(node);
+        return;
+    } else if (node->kind == ND_ADD || node->kind == ND_SUB) {
+        gen(node);
+        return;
+    } else if (node->kind == ND_STRUCT_MEMBER) {
+        gen_addr(node->lhs);
+        pop();
+        emit("  add rax, %ld\n", node->val);
+        push();
+        return;
+    } else if (node->kind == ND_TERNARY) {
+        gen(node);
+        return;
+    } else if (node->kind == ND_SUGER || node->kind == ND_STMT_EXPR) {
+        gen(node);
+        return;
+    }
+
+    error("左辺値がポインターまたは変数ではありません");
+}
+
+// レジスタに割り当てられた変数へ、rdiの値を変数の型の幅で符号拡張して格納する
+static void store_reg(Var *var) {
+    char *reg = reg_name(var->reg);
+    int size = var->type->size;
+    if (size == 8) {
+        emit("  mov %s, rdi\n", reg);
+    } else if (size == 4) {
+        emit("  movsxd %s, edi\n", reg);
+    } else {
+        emit("  movsx %s, %s\n", reg, rdireg[size_to_regindex(size)]);
+    }
+}
+
+// 構造体のコピー (rax: コピー先, rdi: コピー元)
+// 小さい構造体は16, 8, 4, 2, 1バイトの順に大きい単位から転送し、
+// 大きい構造体はrep movsbに任せる。raxとrdiの値は保存する。
+static void gen_struct_copy(int size) {
+    if (size > STRUCT_COPY_REP_THRESHOLD) {
+        emit("  mov rsi, rdi\n");
+        emit("  mov rdx, rax\n");
+        emit("  mov rdi, rax\n");
+        emit("  mov rcx, %d\n", size);
+        emit("  rep movsb\n");
+        emit("  lea rdi, [rsi-%d]\n", size);
+        emit("  mov rax, rdx\n");
+        return;
+    }
+
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        emit("  movdqu xmm0, [rdi+%d]\n", i);
+        emit("  movdqu [rax+%d], xmm0\n", i);
+    }
+    for (int unit = 8; unit >= 1; unit /= 2) {
+        for (; i + unit <= size; i += unit) {
+            char *reg = unit == 8 ? "rdx" : unit == 4 ? "edx" : unit == 2 ? "dx" : "dl";
+            emit("  mov %s, %s PTR [rdi+%d]\n", reg, word_ptr(unit), i);
+            emit("  mov %s PTR [rax+%d], %s\n", word_ptr(unit), i, reg);
+        }
+    }
+}
+
+// raxから始まるsizeバイトを0で埋める (raxの値は保存する)
+static void gen_zero_fill(int size) {
+    if (size > STRUCT_COPY_REP_THRESHOLD) {
+        emit("  mov rdx, rax\n");
+        emit("  mov rdi, rax\n");
+        emit("  mov rcx, %d\n", size);
+        emit("  xor eax, eax\n");
+        emit("  rep stosb\n");
+        emit("  mov rax, rdx\n");
+        return;
+    }
+
+    int i = 0;
+    if (size >= 16) {
+        emit("  pxor xmm0, xmm0\n");
+    }
+    for (; i + 16 <= size; i += 16) {
+        emit("  movdqu [rax+%d], xmm0\n", i);
+    }
+    for (int unit = 8; unit >= 1; unit /= 2) {
+        for (; i + unit <= size; i += unit) {
+            emit("  mov %s PTR [rax+%d], 0\n", word_ptr(unit), i);
+        }
+    }
+}
+
+/*
+ * グローバル変数の初期値の出力
+ *
+ * 初期値のバイト列を先頭から見て
+ *   relocの位置        → .quad ラベル
+ *   8バイト以上の0の連続 → .zero
+ *   文字列らしい部分    → .ascii
+ *   それ以外           → .quad (8バイト単位) と .byte (端数)
+ * にまとめる。
+ */
+#define ZERO_RUN_MIN 8
+#define QUADS_PER_LINE 4
+
+// 文字列リテラルの途中に\0があるか (アセンブラに渡すエスケープのまま調べる)
+static bool has_embedded_nul(char *str) {
+    for (char *p = str; *p; p++) {
+        if (*p != '\\') continue;
+        p++;
+
+        int val = 0, n = 0;
+        if (*p == 'x') {
+            while (isxdigit(p[n + 1])) {
+                val = val * 16 + (isdigit(p[n + 1]) ? p[n + 1] - '0' : tolower(p[n + 1]) - 'a' + 10);
+                n++;
+            }
+        } else {
+            while (n < 3 && '0' <= p[n] && p[n] <= '7') {
+                val = val * 8 + p[n] - '0';
+                n++;
+            }
+        }
+        if (n > 0 && val % 256 == 0) return true;
+    }
+    return false;
+}
+
+static bool is_zero_global(Var *var) {
+    if (!var->init_data) return true;
+    if (var->relocs->len > 0) return false;
+    for (int i = 0; i < var->type->size; i++) {
+        if (var->init_data[i]) return false;
+    }
+    return true;
+}
+
+static int zero_run(char *data, int pos, int end) {
+    int i = pos;
+    while (i < end && data[i] == 0) i++;
+    return i - pos;
+}
+
+static bool is_text(char *data, int pos, int end) {
+    if (end - pos < 4) return false;
+    for (int i = pos; i < end; i++) {
+        char c = data[i];
+        if (c != 0 && c != '\n' && c != '\t' && (c < ' ' || c > '~')) return false;
+    }
+    return true;
+}
+
+static void gen_ascii(char *data, int pos, int end) {
+    char *buf = memory_alloc((end - pos) * 4 + 1);
+    int len = 0;
+    for (int i = pos; i < end; i++) {
+        unsigned char c = data[i];
+        if (c == '"' || c == '\\') {
+            buf[len++] = '\\';
+            buf[len++] = c;
+        } else if (c < ' ' || c > '~') {
+            len += sprintf(buf + len, "\\%03o", c);
+        } else {
+            buf[len++] = c;
+        }
+    }
+    buf[len] = '\0';
+    emit("  .ascii \"%s\"\n", buf);
+}
+
+static void gen_quads(char *data, int pos, int end) {
+    char line[32 * QUADS_PER_LINE];
+    int len = 0;
+    int n = 0;
+    for (; pos + 8 <= end; pos += 8) {
+        unsigned long val = 0;
+        for (int i = 0; i < 8; i++) {
+            val |= (unsigned long)(unsigned char)data[pos + i] << (i * 8);
+        }
+        len += sprintf(line + len, "%s%ld", n == 0 ? "" : ",", (long)val);
+        if (++n == QUADS_PER_LINE) {
+            emit("  .quad %s\n", line);
+            len = n = 0;
+        }
+    }
+    if (n > 0) emit("  .quad %s\n", line);
+    if (pos == end) return;
+    len = 0;
+    for (int i = pos; i < end; i++) {
+        len += sprintf(line + len, "%s%d", i == pos ? "" : ",", (unsigned char)data[i]);
+    }
+    emit("  .byte %s\n", line);
+}
+
+// staticでないグローバル変数は他の翻訳単位から参照できるようにする
+static void gen_global_symbol(Var *var) {
+    if (!var->is_static) {
+        emit(".globl %s\n", var->name);
+    }
+}
+
+static void gen_global(Var *var) {
+    char *data = var->init_data;
+    int size = var->type->size;
+    emit("  .align %d\n", alignOfType(var->type));
+    emit("%s:\n", var->name);
+
+    int pos = 0;
+    int r = 0;
+    while (pos < size) {
+        GInit_el *reloc = r < var->relocs->len ? var->relocs->body[r] : NULL;
+        if (reloc && reloc->val == pos) {
+            emit("  .quad %s\n", reloc->str);
+            pos += 8;
+            r++;
+            continue;
+        }
+        int end = reloc ? reloc->val : size;
+
+        int z = zero_run(data, pos, end);
+        if (z >= ZERO_RUN_MIN || pos + z == end) {
+            emit("  .zero %d\n", z);
+            pos += z;
+            continue;
+        }
+
+        // 次の長い0の連続の手前までをまとめて出力する
+        int i = pos;
+        while (i < end && zero_run(data, i, end) < ZERO_RUN_MIN) i++;
+        if (is_text(data, pos, i)) {
+            gen_ascii(data, pos, i);
+        } else {
+            gen_quads(data, pos, i);
+        }
+        pos = i;
+    }
+}
+
+// 初期化式の定数部分 (ND_TEMPLATE_COPY) のラベル
+// 同じ初期化式を複製したノード (インライン展開など) は同じデータを使う
+static Vector *templates;
+
+static char *template_label(Node *node) {
+    for (int i = 0; i < templates->len; i++) {
+        if (((Node *)templates->body[i])->str_literal == node->str_literal) {
+            return format(".LT%d", i);
+        }
+    }
+    vec_push(templates, node);
+    return format(".LT%d", templates->len - 1);
+}
+
+// メモリオペランドmemの値を型の幅から64bitに符号拡張してregに読みこむ
+static void load_mem(Type *ty, char *reg, char *mem) {
+    if (ty->size == 8) {
+        emit("  mov %s, %s\n", reg, mem);
+    } else if (ty->size == 4) {
+        emit("  movsxd %s, DWORD PTR %s\n", reg, mem);
+    } else {
+        emit("  movsx %s, %s PTR %s\n", reg, word_ptr(ty->size), mem);
+    }
+}
+
+static void load(Type *ty) {
+    if (ty->kind == TYPE_ARRAY || ty->kind == TYPE_STRUCT) {
+        // アドレスのまま読みこむようにする
+        return;
+    }
+    load_mem(ty, "rax", "[rax]");
+}
+
+static bool is_power_of_two(long val) {
+    return val > 0 && (val & (val - 1)) == 0;
+}
+
+static int log2_of(long val) {
+    int k = 0;
+    while ((1L << k) != val) k++;
+    return k;
+}
+
+// 32bitの即値として命令に書けるか
+static bool is_imm32(long val) {
+    return -2147483648L <= val && val <= 2147483647L;
+}
+
+/*
+ * アドレッシングモード (-O1)
+ *
+ * 読み書きする位置を base + index*scale + disp に分解して、メモリオペランドに直接書く。
+ *
+ * a[i]      →  mov eax, [rbp-4008+rcx*4]  (iをレジスタに割り当てていれば [rbp-4008+rbx*4])
+ * gs.c[2]   →  mov rax, [rip+gs+24]
+ * p->x = 1  →  mov DWORD PTR [rax+4], edi
+ *
+ * baseはフレーム上やグローバルの変数、レジスタに割り当てた変数、計算した値 (rax) のどれか。
+ * indexはレジスタに割り当てた変数か計算した値 (rcx)。
+ */
+typedef struct Addr Addr;
+
+struct Addr {
+    Var *var;     // 位置の決まっている変数 (フレーム上かグローバル)
+    Node *base;   // 値がアドレスになる式
+    Node *lval;   // アドレスをgen_addr()で求める左辺値
+    Node *index;  // NULLならなし
+    long scale;
+    long disp;
+    char *base_reg;   // baseを入れたレジスタ
+    char *index_reg;  // indexを入れたレジスタ
+};
+
+static void match_addr(Node *node, Addr *am);
+
+// expr()が式を包むND_SUGERを外す
+static Node *unwrap_suger(Node *node) {
+    while (node->kind == ND_SUGER && node->stmts->len == 1) {
+        node = node->stmts->body[0];
+    }
+    return node;
+}
+
+static bool is_reg_var(Node *node) {
+    return node->kind == ND_VAR && node->var->reg;
+}
+
+// node (整数) を index*scale + disp に分解する
+static bool match_index(Node *node, Addr *am) {
+    Node *x = NULL;
+    long scale, c;
+    if (node->kind == ND_MUL && eval_const(node->rhs, &scale)) {
+        x = node->lhs;
+    } else if (node->kind == ND_MUL && eval_const(node->lhs, &scale)) {
+        x = node->rhs;
+    } else if (node->kind == ND_LSHIFT && eval_const(node->rhs, &c) && 0 <= c && c <= 3) {
+        x = node->lhs;
+        scale = 1L << c;
+    }
+    if (x == NULL || (scale != 1 && scale != 2 && scale != 4 && scale != 8)) {
+        return false;
+    }
+
+    // (i + 1) * 4 → i*4 + 4 (アドレスの計算は64bitなので結果は変わらない)
+    x = unwrap_suger(x);
+    while ((x->kind == ND_ADD || x->kind == ND_SUB) && eval_const(x->rhs, &c)) {
+        am->disp += (x->kind == ND_ADD ? c : -c) * scale;
+        x = unwrap_suger(x->lhs);
+    }
+    am->index = x;
+    am->scale = scale;
+    return true;
+}
+
+// 左辺値nodeの位置を分解する
+static void match_lval(Node *node, Addr *am) {
+    node = unwrap_suger(node);
+    if (node->kind == ND_DEREF) {
+        match_addr(node->lhs, am);
+    } else if (node->kind == ND_VAR && !node->var->reg) {
+        am->var = node->var;
+    } else if (node->kind == ND_STRUCT_MEMBER) {
+        am->disp += node->val;
+        match_lval(node->lhs, am);
+    } else {
+        am->lval = node;
+    }
+}
+
+// 値がアドレスになるnodeを分解する
+static void match_addr(Node *node, Addr *am) {
+    node = unwrap_suger(node);
+    long val;
+    if (node->kind == ND_ADD && eval_const(node->lhs, &val)) {
+        am->disp += val;
+        match_addr(node->rhs, am);
+        return;
+    }
+    if ((node->kind == ND_ADD || node->kind == ND_SUB) && eval_const(node->rhs, &val)) {
+        am->disp += node->kind == ND_ADD ? val : -val;
+        match_addr(node->lhs, am);
+        return;
+    }
+    if (node->kind == ND_ADD && am->index == NULL) {
+        if (match_index(node->lhs, am)) {
+            match_addr(node->rhs, am);
+            return;
+        }
+        if (match_index(node->rhs, am)) {
+            match_addr(node->lhs, am);
+            return;
+        }
+        // レジスタに割り当てた変数はそのままindexにできる
+        for (int i = 0; i < 2; i++) {
+            Node *reg = unwrap_suger(i == 0 ? node->rhs : node->lhs);
+            if (is_reg_var(reg)) {
+                am->index = reg;
+                am->scale = 1;
+                match_addr(i == 0 ? node->lhs : node->rhs, am);
+                return;
+            }
+        }
+    }
+
+    // 配列は暗黙にアドレスになる
+    if (node->kind == ND_ADDR || (node->type && node->type->kind == TYPE_ARRAY &&
+                                  (node->kind == ND_VAR || node->kind == ND_DEREF || node->kind == ND_STRUCT_MEMBER))) {
+        match_lval(node->kind == ND_ADDR ? node->lhs : node, am);
+        return;
+    }
+    am->base = node;
+}
+
+/*
+ * 部品はbase, indexの順に計算し、レジスタの変数は最後に読むので、式に書いた順とは変わる。
+ * レジスタの割り当ては式に書いた順で変数の生存区間を決めているので、
+ * 副作用のある部品は他の部品と一緒には使わない。
+ */
+static bool is_reorderable(Addr *am) {
+    Node *parts[] = {am->base, am->lval, am->index};
+    int n = 0;
+    bool pure = true;
+    for (int i = 0; i < 3; i++) {
+        if (parts[i] == NULL) continue;
+        n++;
+        if (!is_pure(parts[i])) pure = false;
+    }
+    return pure || n <= 1;
+}
+
+// 左辺値nodeの位置をアドレッシングモードで書けるか (raxに計算するだけなら使わない)
+static bool match_mem(Node *node, Addr *am) {
+    if (opt_level < 1) {
+        return false;
+    }
+
+    memset(am, 0, sizeof(Addr));
+    match_lval(node, am);
+    if (!is_reorderable(am)) {
+        return false;
+    }
+    if (!is_imm32(am->disp) || (am->var && !am->var->is_global && !is_imm32(am->disp - am->var->offset))) {
+        return false;
+    }
+    bool base_in_reg = am->base && is_reg_var(am->base);
+    return am->var || am->index || am->disp != 0 || base_in_reg;
+}
+
+// アドレスの部品のうち計算が必要なもの (base, indexの順) を積む
+static void gen_addr_parts(Addr *am) {
+    if (am->base && !is_reg_var(am->base)) {
+        gen(am->base);
+    } else if (am->lval) {
+        gen_addr(am->lval);
+    }
+    if (am->index && !is_reg_var(am->index)) {
+        gen(am->index);
+    }
+}
+
+// 積んだ部品をrcx (index), rax (base) に下ろす
+static void pop_addr_parts(Addr *am) {
+    if (am->index && is_reg_var(am->index)) {
+        am->index_reg = reg_name(am->index->var->reg);
+    } else if (am->index) {
+        pop_reg("rcx");
+        am->index_reg = "rcx";
+    }
+
+    if (am->base && is_reg_var(am->base)) {
+        am->base_reg = reg_name(am->base->var->reg);
+    } else if (am->base || am->lval) {
+        pop();
+        am->base_reg = "rax";
+    } else if (am->var->is_global && am->index) {
+        // rip相対にはindexを付けられない
+        emit("  lea rax, [rip+%s]\n", am->var->name);
+        am->base_reg = "rax";
+    }
+}
+
+// メモリオペランドを作る (rsp相対の位置は今実際に積んでいる数で決まる)
+static char *addr_operand(Addr *am) {
+    char *base = am->base_reg;
+    long disp = am->disp;
+    if (base) {
+        // 計算済み
+    } else if (am->var->is_global) {
+        base = format("rip+%s", am->var->name);
+    } else if (!current_fn->omit_frame_pointer) {
+        base = "rbp";
+        disp -= am->var->offset;
+    } else {
+        base = "rsp";
+        disp += frame_base + phys_depth() * 8 - am->var->offset;
+    }
+
+    char *mem = format("[%s", base);
+    if (am->index_reg) mem = format("%s+%s", mem, am->index_reg);
+    if (am->index_reg && am->scale > 1) mem = format("%s*%ld", mem, am->scale);
+    if (disp > 0) mem = format("%s+%ld", mem, disp);
+    if (disp < 0) mem = format("%s-%ld", mem, -disp);
+    return format("%s]", mem);
+}
+
+// 左辺値nodeのアドレスをleaで求める (アドレッシングモードで書けなければfalse)
+static bool gen_lea(Node *node) {
+    Addr am;
+    if (!match_mem(node, &am)) {
+        return false;
+    }
+    gen_addr_parts(&am);
+    pop_addr_parts(&am);
+    emit("  lea rax, %s\n", addr_operand(&am));
+    push();
+    return true;
+}
+
+// 左辺値nodeの値を読みこむ (アドレッシングモードで書けなければfalse)
+static bool gen_load(Node *node) {
+    Addr am;
+    add_type(node);
+    if (node->type->kind == TYPE_ARRAY || node->type->kind == TYPE_STRUCT) {
+        return gen_lea(node);
+    }
+    if (!match_mem(node, &am)) {
+        return false;
+    }
+    gen_addr_parts(&am);
+    pop_addr_parts(&am);
+    load_mem(node->type, "rax", addr_operand(&am));
+    push();
+    return true;
+}
+
+// 左辺値nodeが何も計算せずにアドレッシングモードで書けるか (ベースとインデックスはレジスタの変数だけ)
+static bool match_direct_mem(Node *node, Addr *am) {
+    add_type(node);
+    if (is_reg_var(node) || !match_mem(node, am)) {
+        return false;
+    }
+    if (am->lval || (am->base && !is_reg_var(am->base)) || (am->index && !is_reg_var(am->index))) {
+        return false;
+    }
+    return !(am->var && am->var->is_global && am->index);
+}
+
+// rax *= val
+static void gen_mul_const(long val) {
+    if (val == 0) {
+        emit("  mov rax, 0\n");
+        return;
+    }
+
+    bool neg = val < 0 && val != LONG_MIN;
+    long abs = neg ? -val : val;
+
+    // 2^k, 3*2^k, 5*2^k, 9*2^k はleaとshlで計算する
+    int shift = 0;
+    while (abs > 1 && abs % 2 == 0 && abs != LONG_MIN) {
+        abs /= 2;
+        shift++;
+    }
+
+    if (abs == 1 || abs == 3 || abs == 5 || abs == 9) {
+        if (abs != 1) {
+            emit("  lea rax, [rax+rax*%ld]\n", abs - 1);
+        }
+        if (shift > 0) {
+            emit("  shl rax, %d\n", shift);
+        }
+        if (neg) {
+            emit("  neg rax\n");
+        }
+        return;
+    }
+
+    if (is_imm32(val)) {
+        emit("  imul rax, rax, %ld\n", val);
+    } else {
+        emit("  mov rdi, %ld\n", val);
+        emit("  imul rax, rdi\n");
+    }
+}
+
+// 符号付き64bit除算のマジックナンバー (Hacker's Delight 10-1)
+// n / d == (mulhi(n, magic) (+ n if needed) >> shift) + (結果が負なら1)
+static void signed_magic(long d, long *magic, int *shift) {
+    unsigned long two63 = 1UL << 63;
+    unsigned long ad = d < 0 ? -(unsigned long)d : d;
+    unsigned long t = two63 + ((unsigned long)d >> 63);
+    unsigned long anc = t - 1 - t % ad;
+    int p = 63;
+    unsigned long q1 = two63 / anc, r1 = two63 - q1 * anc;
+    unsigned long q2 = two63 / ad, r2 = two63 - q2 * ad;
+    unsigned long delta;
+
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *magic = (long)(q2 + 1);
+    if (d < 0) *magic = -*magic;
+    *shift = p - 64;
+}
+
+// rax /= val (0への丸め)
+// raxの元の値はrcxに残す
+static void gen_div_const(long val) {
+    emit("  mov rcx, rax\n");
+
+    if (val == 1) {
+        return;
+    }
+    if (val == -1) {
+        emit("  neg rax\n");
+        return;
+    }
+
+    long abs = val < 0 ? -val : val;
+    if (is_power_of_two(abs)) {
+        // 負数は 2^k-1 を足してから算術シフトすると0方向に丸められる
+        int k = log2_of(abs);
+        emit("  mov rdi, rax\n");
+        emit("  sar rdi, 63\n");
+        emit("  shr rdi, %d\n", 64 - k);
+        emit("  add rax, rdi\n");
+        emit("  sar rax, %d\n", k);
+        if (val < 0) {
+            emit("  neg rax\n");
+        }
+        return;
+    }
+
+    long magic;
+    int shift;
+    signed_magic(val, &magic, &shift);
+    emit("  mov rdi, %ld\n", magic);
+    emit("  imul rdi\n");
+    if (val > 0 && magic < 0) {
+        emit("  add rdx, rcx\n");
+    } else if (val < 0 && magic > 0) {
+        emit("  sub rdx, rcx\n");
+    }
+    if (shift > 0) {
+        emit("  sar rdx, %d\n", shift);
+    }
+    emit("  mov rax, rdx\n");
+    emit("  shr rax, 63\n");
+    emit("  add rax, rdx\n");
+}
+
+// rax %= val (符号は被除数に従う)
+static void gen_mod_const(long val) {
+    long abs = val < 0 ? -val : val;
+    if (abs == 1) {
+        emit("  mov rax, 0\n");
+        return;
+    }
+
+    if (is_power_of_two(abs) && is_imm32(abs - 1)) {
+        int k = log2_of(abs);
+        emit("  mov rdi, rax\n");
+        emit("  sar rdi, 63\n");
+        emit("  shr rdi, %d\n", 64 - k);
+        emit("  add rax, rdi\n");
+        emit("  and rax, %ld\n", abs - 1);
+        emit("  sub rax, rdi\n");
+        return;
+    }
+
+    // n - (n / val) * val
+    gen_div_const(abs);
+    gen_mul_const(abs);
+    emit("  sub rcx, rax\n");
+    emit("  mov rax, rcx\n");
+}
+
+// 右辺 (乗算は左辺も) が定数の乗算・除算・剰余を軽い命令列に置き換える
+// 置き換えた場合はtrueを返す
+static bool gen_strength_reduced(Node *node) {
+    if (opt_level < 1) {
+        return false;
+    }
+    if (node->kind != ND_MUL && node->kind != ND_DIV && node->kind != ND_MOD) {
+        return false;
+    }
+
+    Node *lhs = node->lhs;
+    Node *rhs = node->rhs;
+    if (node->kind == ND_MUL && lhs->kind == ND_NUM && rhs->kind != ND_NUM) {
+        lhs = node->rhs;
+        rhs = node->lhs;
+    }
+    if (rhs->kind != ND_NUM) {
+        return false;
+    }
+
+    long val = rhs->val;
+    // 0除算はidivに任せ、LONG_MINは絶対値が表せないので扱わない
+    if (node->kind != ND_MUL && (val == 0 || val == LONG_MIN)) {
+        return false;
+    }
+
+    gen(lhs);
+    pop();
+    if (node->kind == ND_MUL) {
+        gen_mul_const(val);
+    } else if (node->kind == ND_DIV) {
+        gen_div_const(val);
+    } else {
+        gen_mod_const(val);
+    }
+    push();
+    return true;
+}
+
+/*
+ * 命令の選択 (-O1)
+ *
+ * 二項演算の右辺が即値かレジスタに割り当てた変数なら、スタックを使わずに
+ *   op rax, imm  /  op rax, reg
+ * の一命令で計算する。比較はcmpの後にsetccで0か1にする。
+ * 足し算の部品がレジスタの変数と定数だけなら lea rax, [rbx+r12*4+8] の一命令にする。
+ *
+ * 値はraxの64bit全体に符号拡張しておく約束なので、intの加減算や論理演算は64bitの命令で行う
+ * (32bitの命令にすると符号拡張し直す命令が増えるだけで速くならない)。
+ * intどうしの割り算だけは32bitのidivの方が速いので、cdqとidiv ediを使って結果を符号拡張する。
+ */
+typedef struct BinInsn BinInsn;
+
+struct BinInsn {
+    NodeKind kind;
+    char *insn;
+    char *setcc;       // 比較ならその結果を取り出す命令
+    bool imm_only;     // 右辺に即値しか書けない (シフト)
+    bool commutative;  // 左辺と右辺を入れ替えられる
+};
+
+static BinInsn bin_insns[] = {
+    {ND_ADD, "add", NULL, false, true},
+    {ND_SUB, "sub", NULL, false, false},
+    {ND_MUL, "imul", NULL, false, true},
+    {ND_AND, "and", NULL, false, true},
+    {ND_OR, "or", NULL, false, true},
+    {ND_XOR, "xor", NULL, false, true},
+    {ND_LSHIFT, "sal", NULL, true, false},
+    {ND_RSHIFT, "sar", NULL, true, false},
+    {ND_EQ, "cmp", "sete", false, true},
+    {ND_NE, "cmp", "setne", false, true},
+    {ND_LT, "cmp", "setl", false, false},
+    {ND_LE, "cmp", "setle", false, false},
+};
+
+static BinInsn *find_bin_insn(NodeKind kind) {
+    for (int i = 0; i < sizeof(bin_insns) / sizeof(BinInsn); i++) {
+        if (bin_insns[i].kind == kind) return &bin_insns[i];
+    }
+    return NULL;
+}
+
+// 計算せずに命令のオペランドに書ける式 (即値かレジスタに割り当てた変数)
+static char *simple_operand(Node *node, bool imm_only) {
+    node = unwrap_suger(node);
+    long val;
+    if (eval_const(node, &val)) {
+        if (imm_only && (val < 0 || val > 63)) return NULL;
+        return is_imm32(val) ? format("%ld", val) : NULL;
+    }
+    if (!imm_only && is_reg_var(node)) {
+        return reg_name(node->var->reg);
+    }
+    return NULL;
+}
+
+static bool gen_binary_simple(Node *node) {
+    BinInsn *bi = find_bin_insn(node->kind);
+    if (opt_level < 1 || bi == NULL) {
+        return false;
+    }
+
+    Node *lhs = node->lhs;
+    Node *rhs = node->rhs;
+    // 入れ替えると左辺の変数を後で読むことになるので、右辺に副作用があれば入れ替えない
+    if (!simple_operand(rhs, bi->imm_only) && bi->commutative && simple_operand(lhs, bi->imm_only) && is_pure(rhs)) {
+        lhs = node->rhs;
+        rhs = node->lhs;
+    }
+    char *src = simple_operand(rhs, bi->imm_only);
+    if (src == NULL) {
+        return false;
+    }
+
+    gen(lhs);
+    pop();
+    emit("  %s rax, %s\n", bi->insn, src);
+    if (bi->setcc) {
+        emit("  %s al\n", bi->setcc);
+        emit("  movzb rax, al\n");
+    }
+    push();
+    return true;
+}
+
+// 値がintに収まる式か
+// (加減乗除の型はadd_type()で常にintになるので、型ではなく葉の変数や定数で判定する)
+static bool is_int_value(Node *node) {
+    switch (node->kind) {
+    case ND_NUM:
+        return node->val == (int)node->val;
+    case ND_VAR:
+    case ND_DEREF:
+    case ND_STRUCT_MEMBER:
+    case ND_CALL:
+    case ND_CAST:
+        return is_integertype(node->type->kind) && node->type->size <= 4;
+    case ND_ADD:
+    case ND_SUB:
+    case ND_MUL:
+    case ND_DIV:
+    case ND_MOD:
+    case ND_AND:
+    case ND_OR:
+    case ND_XOR:
+        return is_int_value(node->lhs) && is_int_value(node->rhs);
+    default:
+        return false;
+    }
+}
+
+// 被演算子がどちらもintに収まる割り算 (32bitのidivを使える)
+static bool is_int_div(Node *node) {
+    return opt_level >= 1 && is_int_value(node->lhs) && is_int_value(node->rhs);
+}
+
+// 足し算をleaの一命令にする (部品を計算する必要がなければtrue)
+static bool gen_add_lea(Node *node) {
+    if (opt_level < 1 || (node->kind != ND_ADD && node->kind != ND_SUB)) {
+        return false;
+    }
+
+    Addr am;
+    memset(&am, 0, sizeof(Addr));
+    match_addr(node, &am);
+    if (am.lval || (am.base && !is_reg_var(am.base)) || (am.index && !is_reg_var(am.index))) {
+        return false;
+    }
+    if (!is_imm32(am.disp) || (am.var && !am.var->is_global && !is_imm32(am.disp - am.var->offset))) {
+        return false;
+    }
+
+    pop_addr_parts(&am);
+    emit("  lea rax, %s\n", addr_operand(&am));
+    push();
+    return true;
+}
+
+/*
+ * 被演算子の計算順 (-O1)
+ *
+ * Sethi-Ullman数で部分式を計算するのに必要なスタックの深さを見積もり、
+ * 深い方の被演算子を先に計算する。もう一方を計算する間に積んでおく値は一つで済む。
+ *
+ * a + (b * (c + d * e))  →  右辺を先に計算する (深さ3が2になる)
+ *
+ * 評価順を変えるとレジスタの変数の生存区間が変わるので、副作用のない式に限る。
+ */
+
+// 計算せずにオペランドに書ける式は0、それ以外の葉は1
+static int su_number(Node *node) {
+    node = unwrap_suger(node);
+    if (simple_operand(node, false)) {
+        return 0;
+    }
+
+    switch (node->kind) {
+        case ND_ADD:
+        case ND_SUB:
+        case ND_MUL:
+        case ND_DIV:
+        case ND_MOD:
+        case ND_EQ:
+        case ND_NE:
+        case ND_LT:
+        case ND_LE:
+        case ND_LSHIFT:
+        case ND_RSHIFT:
+        case ND_AND:
+        case ND_OR:
+        case ND_XOR: {
+            int l = su_number(node->lhs);
+            int r = su_number(node->rhs);
+            if (l == r) return l + 1;
+            return l > r ? l : r;
+        }
+        case ND_DEREF:
+        case ND_CAST:
+        case ND_NOT:
+        case ND_LOGICALNOT:
+        case ND_STRUCT_MEMBER: {
+            int n = su_number(node->lhs);
+            return n > 0 ? n : 1;
+        }
+        default:
+            return 1;
+    }
+}
+
+// 二項演算の被演算子をrax (左辺) とrdi (右辺) に計算する
+static void gen_operands(Node *lhs, Node *rhs) {
+    // 右辺がそのまま読めるメモリなら、スタックを通さずにrdiに読みこむ
+    Addr am;
+    if (match_direct_mem(rhs, &am)) {
+        gen(lhs);
+        pop();
+        pop_addr_parts(&am);
+        if (rhs->type->kind == TYPE_ARRAY || rhs->type->kind == TYPE_STRUCT) {
+            emit("  lea rdi, %s\n", addr_operand(&am));
+        } else {
+            load_mem(rhs->type, "rdi", addr_operand(&am));
+        }
+        return;
+    }
+
+    if (opt_level >= 1 && su_number(rhs) > su_number(lhs) && is_pure(lhs) && is_pure(rhs)) {
+        gen(rhs);
+        gen(lhs);
+        pop();
+        pop_rdi();
+        return;
+    }
+
+    gen(lhs);
+    gen(rhs);
+    pop_rdi();
+    pop();
+}
+
+// 評価しても引数レジスタを壊さない (raxしか使わない) 引数か
+static bool is_simple_arg(Node *node) {
+    if (node->kind == ND_NUM || node->kind == ND_STRING || node->kind == ND_VAR) {
+        return true;
+    }
+    return node->kind == ND_ADDR && node->lhs->kind == ND_VAR;
+}
+
+// 単純な引数を直接regに入れる
+static void gen_arg(Node *node, char *reg) {
+    if (node->kind == ND_NUM) {
+        emit("  mov %s, %ld\n", reg, node->val);
+        return;
+    }
+    if (node->kind == ND_VAR && node->var->reg) {
+        emit("  mov %s, %s\n", reg, reg_name(node->var->reg));
+        return;
+    }
+
+    gen(node);
+    pop();
+    emit("  mov %s, rax\n", reg);
+}
+
+// 引数を引数レジスタに入れる
+static void gen_call_args(Node *node) {
+    // 引数レジスタを壊しうる引数を先にスタックに積んでおき、
+    // 単純な引数は最後に直接レジスタに入れる
+    int nargs = node->args->len;
+    for (int i = 0; i < nargs; i++) {
+        if (!is_simple_arg(node->args->body[i])) {
+            gen(node->args->body[i]);
+        }
+    }
+    for (int i = nargs - 1; i >= 0; i--) {
+        if (!is_simple_arg(node->args->body[i])) {
+            pop_reg(argreg64[i]);
+        }
+    }
+    for (int i = 0; i < nargs; i++) {
+        if (is_simple_arg(node->args->body[i])) {
+            gen_arg(node->args->body[i], argreg64[i]);
+        }
+    }
+}
+
+/*
+ * 末尾呼び出し (return f(...);)
+ *
+ * 呼び出し元のフレームを片付けてからjmpで呼び出し先に飛ぶ。
+ * 自分自身の呼び出しはプロローグの後 (引数の格納の前) に戻るループになる。
+ * 引数はレジスタだけで渡すので、フレームのアドレスが外に漏れていなければよい。
+ */
+
+// callee-savedレジスタを戻してスタックフレームを片付ける (depthが0の位置で使う)
+static void gen_epilogue() {
+    for (int k = 0; k < current_fn->saved_regs->len; k++) {
+        emit("  mov %s, %s\n", current_fn->saved_regs->body[k], frame_slot(current_fn->stack_size - k * 8));
+    }
+    if (!current_fn->omit_frame_pointer) {
+        emit("  mov rsp, rbp\n");
+        emit("  pop rbp\n");
+    } else if (frame_size > 0) {
+        emit("  add rsp, %d\n", frame_size);
+    }
+}
+
+static Function *find_func_def(char *name) {
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        if (!fn->is_prototype && strcmp(fn->name, name) == 0) {
+            return fn;
+        }
+    }
+    return NULL;
+}
+
+// ローカル変数のアドレスを取っているか (配列は暗黙にアドレスになる)
+static bool has_escaped_local(Node *node) {
+    if (node == NULL) return false;
+    if (node->kind == ND_ADDR && (node->lhs->kind == ND_VAR || node->lhs->kind == ND_STRUCT_MEMBER)) {
+        if (node->lhs->kind == ND_STRUCT_MEMBER || !node->lhs->var->is_global) return true;
+    }
+    if (node->kind == ND_VAR && !node->var->is_global && node->var->type->kind == TYPE_ARRAY) {
+        return true;
+    }
+
+    if (has_escaped_local(node->lhs) || has_escaped_local(node->rhs)) return true;
+    if (has_escaped_local(node->cond) || has_escaped_local(node->then) || has_escaped_local(node->els)) return true;
+    if (has_escaped_local(node->body) || has_escaped_local(node->init) || has_escaped_local(node->inc)) return true;
+    for (int i = 0; node->args && i < node->args->len; i++) {
+        if (has_escaped_local(node->args->body[i])) return true;
+    }
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) {
+        if (has_escaped_local(node->stmts->body[i])) return true;
+    }
+    return false;
+}
+
+static bool can_tail_call;  // 現在の関数で末尾呼び出しを使えるか
+
+static bool is_tail_call(Node *node) {
+    if (!can_tail_call || node->kind != ND_CALL || strcmp(node->fn_name, "va_start") == 0) {
+        return false;
+    }
+
+    // 自分で生成した関数なら返り値はraxに型の大きさで符号拡張されている
+    Function *callee = find_func_def(node->fn_name);
+    if (callee == NULL) return false;
+    Type *ret = callee->ret_type;
+    return ret->kind != TYPE_STRUCT && ret->kind == current_fn->ret_type->kind && ret->size == current_fn->ret_type->size;
+}
+
+static void gen_tail_call(Node *node) {
+    gen_call_args(node);
+
+    if (strcmp(node->fn_name, current_fn->name) == 0) {
+        unwind_to(0);
+        emit("  jmp .L.tailcall.%s\n", current_fn->name);
+        return;
+    }
+
+    unwind_to(0);
+    gen_epilogue();
+    if (find_func_def(node->fn_name)->is_variadic) {
+        emit("  mov rax, 0\n");
+    }
+    emit("  jmp %s\n", node->fn_name);
+}
+
+// 比較の結果がtrueのときに分岐する命令
+static char *jcc_true(NodeKind kind) {
+    if (kind == ND_EQ) return "je";
+    if (kind == ND_NE) return "jne";
+    if (kind == ND_LT) return "jl";
+    if (kind == ND_LE) return "jle";
+    error("jcc_true() failure: 比較演算子ではありません [%d]", kind);
+    return NULL;
+}
+
+// 比較の結果がfalseのときに分岐する命令
+static char *jcc_false(NodeKind kind) {
+    if (kind == ND_EQ) return "jne";
+    if (kind == ND_NE) return "je";
+    if (kind == ND_LT) return "jge";
+    if (kind == ND_LE) return "jg";
+    error("jcc_false() failure: 比較演算子ではありません [%d]", kind);
+    return NULL;
+}
+
+// 条件式を評価し、真偽がjump_ifと一致したらlabelへ分岐する
+// 比較は0/1の値を作らずにcmpとjccにする (スタックには何も残さない)
+static void gen_branch(Node *node, bool jump_if, char *label) {
+    NodeKind kind = node->kind;
+    if (kind == ND_LOGICALNOT) {
+        gen_branch(node->lhs, !jump_if, label);
+        return;
+    }
+
+    if (kind == ND_LOGICAL_AND || kind == ND_LOGICAL_OR) {
+        // a && b が偽 (a || b が真) になるのは、左辺だけで決まる場合と右辺で決まる場合
+        bool is_and = kind == ND_LOGICAL_AND;
+        if (jump_if != is_and) {
+            gen_branch(node->lhs, jump_if, label);
+            gen_branch(node->rhs, jump_if, label);
+            return;
+        }
+
+        // 左辺で結果が決まったら右辺を飛ばす
+        char *skip = format(".Llogical%04d", label_logical_count++);
+        gen_branch(node->lhs, !jump_if, skip);
+        gen_branch(node->rhs, jump_if, label);
+        emit("%s:\n", skip);
+        return;
+    }
+
+    if (kind == ND_NUM) {
+        if ((node->val != 0) == jump_if) {
+            emit("  jmp %s\n", label);
+        }
+        return;
+    }
+
+    if (kind == ND_EQ || kind == ND_NE || kind == ND_LT || kind == ND_LE) {
+        // 右辺を直接cmpに書けて、左辺もレジスタの変数ならraxを経由しない
+        char *src = opt_level >= 1 ? simple_operand(node->rhs, false) : NULL;
+        if (src) {
+            char *dst = "rax";
+            if (is_reg_var(unwrap_suger(node->lhs))) {
+                dst = reg_name(unwrap_suger(node->lhs)->var->reg);
+            } else {
+                gen(node->lhs);
+                pop();
+            }
+            if (strcmp(src, "0") == 0) {
+                emit("  test %s, %s\n", dst, dst);
+            } else {
+                emit("  cmp %s, %s\n", dst, src);
+            }
+            emit("  %s %s\n", jump_if ? jcc_true(kind) : jcc_false(kind), label);
+            return;
+        }
+
+        gen_operands(node->lhs, node->rhs);
+        emit("  cmp rax, rdi\n");
+        emit("  %s %s\n", jump_if ? jcc_true(kind) : jcc_false(kind), label);
+        return;
+    }
+
+    gen(node);
+    pop();
+    emit("  test rax, rax\n");
+    emit("  %s %s\n", jump_if ? "jne" : "je ", label);
+}
+
+// ループの本体を生成する (countはループの番号)
+static void gen_loop_body(Node *body, int count) {
+    int outer_count = now_loop_count, outer_depth = loop_depth;
+    int outer_continue_count = continue_count, outer_continue_depth = continue_depth;
+    now_loop_count = continue_count = count + 1;
+    loop_depth = continue_depth = depth;
+
+    gen_stmt(body);
+
+    now_loop_count = outer_count;
+    loop_depth = outer_depth;
+    continue_count = outer_continue_count;
+    continue_depth = outer_continue_depth;
+}
+
+/*
+ * switch文
+ *
+ * 条件式の値をrcxに入れ、caseの値の分布に応じて分岐の方法を選ぶ。
+ *   ビットテスト:     値の範囲が64以下で飛び先が少ないとき。飛び先ごとに値の集合をビット列にしてbtで調べる
+ *   ジャンプテーブル: caseが密に並んでいるとき。.rodataの表を引いて間接ジャンプする
+ *   比較の二分木:     それ以外。値の中央で二つに分けながら比較する
+ */
+
+#define SWITCH_BT_MAX_TARGETS 3      // ビットテストにする飛び先の数の上限
+#define SWITCH_TABLE_MIN_CASES 4     // ジャンプテーブルにするcaseの数の下限
+#define SWITCH_TABLE_MAX_RANGE 4096  // ジャンプテーブルの大きさの上限
+#define SWITCH_LINEAR_MAX 3          // これ以下のcaseは二分木にせずに順に比較する
+
+static int label_switch_count = 0;
+static Vector *case_nodes;   // ラベルをつけたcase
+static Vector *case_labels;  // そのラベル
+
+static bool is_case_node(Node *node) {
+    return node->kind == ND_CASE || node->kind == ND_DEFAULT;
+}
+
+static char *case_label(Node *node) {
+    while (is_case_node(node->lhs)) {
+        node = node->lhs;
+    }
+    // 本体の生成をやり直すことがあるので新しい方から探す
+    for (int i = case_nodes->len - 1; i >= 0; i--) {
+        if (case_nodes->body[i] == node) {
+            return case_labels->body[i];
+        }
+    }
+    error("case_label() failure: ラベルのないcaseです");
+}
+
+// rcxとvalを比較する
+static void gen_cmp_rcx(long val) {
+    if (is_imm32(val)) {
+        emit("  cmp rcx, %ld\n", val);
+    } else {
+        emit("  mov rdx, %ld\n", val);
+        emit("  cmp rcx, rdx\n");
+    }
+}
+
+// rcxから最小値を引き、範囲外ならdefaultに飛ぶ
+static void gen_range_check(long min, long range, char *default_label) {
+    if (is_imm32(min)) {
+        if (min != 0) emit("  sub rcx, %ld\n", min);
+    } else {
+        emit("  mov rdx, %ld\n", min);
+        emit("  sub rcx, rdx\n");
+    }
+    emit("  cmp rcx, %ld\n", range - 1);
+    emit("  ja %s\n", default_label);
+}
+
+static void gen_case_tree(Vector *cases, int lo, int hi, char *default_label) {
+    if (hi - lo <= SWITCH_LINEAR_MAX) {
+        for (int i = lo; i < hi; i++) {
+            Node *c = cases->body[i];
+            gen_cmp_rcx(c->val);
+            emit("  je %s\n", case_label(c));
+        }
+        emit("  jmp %s\n", default_label);
+        return;
+    }
+
+    int mid = (lo + hi) / 2;
+    Node *c = cases->body[mid];
+    char *upper = format(".Lswitch%04d", label_switch_count++);
+    gen_cmp_rcx(c->val);
+    emit("  je %s\n", case_label(c));
+    emit("  jg %s\n", upper);
+    gen_case_tree(cases, lo, mid, default_label);
+    emit("%s:\n", upper);
+    gen_case_tree(cases, mid + 1, hi, default_label);
+}
+
+static void gen_jump_table(Vector *cases, char *default_label) {
+    long min = ((Node *)cases->body[0])->val;
+    long range = ((Node *)vec_last(cases))->val - min + 1;
+    char *table = format(".Lswitch%04d", label_switch_count++);
+
+    gen_range_check(min, range, default_label);
+    emit("  lea rdx, [rip+%s]\n", table);
+    emit("  movsxd rcx, DWORD PTR [rdx+rcx*4]\n");
+    emit("  add rcx, rdx\n");
+    emit("  jmp rcx\n");
+
+    // 表には表の先頭からの相対位置を入れる
+    emit(".section .rodata\n");
+    emit(".align 4\n");
+    emit("%s:\n", table);
+    int k = 0;
+    for (long v = min; v < min + range; v++) {
+        char *label = default_label;
+        if (((Node *)cases->body[k])->val == v) {
+            label = case_label(cases->body[k++]);
+        }
+        emit("  .long %s-%s\n", label, table);
+    }
+    emit(".text\n");
+}
+
+static void gen_bit_test(Vector *cases, Vector *targets, Vector *masks, char *default_label) {
+    long min = ((Node *)cases->body[0])->val;
+    long range = ((Node *)vec_last(cases))->val - min + 1;
+
+    gen_range_check(min, range, default_label);
+    for (int i = 0; i < targets->len; i++) {
+        emit("  mov rdx, %ld\n", (long)masks->body[i]);
+        emit("  bt rdx, rcx\n");
+        emit("  jc %s\n", (char *)targets->body[i]);
+    }
+    emit("  jmp %s\n", default_label);
+}
+
+static void gen_switch(Node *node) {
+    int count = label_loop_count++;
+    gen(node->cond);
+    pop_reg("rcx");
+    add_type(node->cond);
+    if (node->cond->type->size <= 4) {
+        // 4バイト以下の値は上位32ビットが符号拡張されていないことがある
+        emit("  movsxd rcx, ecx\n");
+    }
+
+    Node *default_case;
+    Vector *cases = switch_cases(node, &default_case);
+    for (int i = 0; i < cases->len; i++) {
+        vec_push(case_nodes, cases->body[i]);
+        vec_push(case_labels, format(".Lcase%04d", label_switch_count++));
+    }
+    if (default_case) {
+        vec_push(case_nodes, default_case);
+        vec_push(case_labels, format(".Lcase%04d", label_switch_count++));
+    }
+
+    char *end_label = format(".Lloopend%04d", count);
+    char *default_label = default_case ? case_label(default_case) : end_label;
+
+    if (cases->len == 0) {
+        emit("  jmp %s\n", default_label);
+    } else {
+        long min = ((Node *)cases->body[0])->val;
+        long max = ((Node *)vec_last(cases))->val;
+        long range = max - min + 1;  // 値が離れすぎているときは負になる
+
+        // 飛び先ごとに値の集合をビット列にする (同じ位置のcaseはまとめる)
+        Vector *targets = new_vec();
+        Vector *masks = new_vec();
+        if (range > 0 && range <= 64) {
+            for (int i = 0; i < cases->len; i++) {
+                Node *c = cases->body[i];
+                char *label = case_label(c);
+                int t = 0;
+                while (t < targets->len && strcmp(targets->body[t], label) != 0) t++;
+                if (t == targets->len) {
+                    vec_push(targets, label);
+                    vec_push(masks, 0);
+                }
+                masks->body[t] = (void *)((long)masks->body[t] | (1L << (c->val - min)));
+            }
+        }
+
+        if (range > 0 && range <= 64 && cases->len > SWITCH_LINEAR_MAX && targets->len <= SWITCH_BT_MAX_TARGETS) {
+            gen_bit_test(cases, targets, masks, default_label);
+        } else if (cases->len >= SWITCH_TABLE_MIN_CASES && range > 0 && range <= SWITCH_TABLE_MAX_RANGE &&
+                   range <= cases->len * 3) {
+            gen_jump_table(cases, default_label);
+        } else {
+            gen_case_tree(cases, 0, cases->len, default_label);
+        }
+    }
+
+    // switchの中のbreakは末尾に飛ぶ
+    int outer_count = now_loop_count, outer_depth = loop_depth;
+    now_loop_count = count + 1;
+    loop_depth = depth;
+    gen_stmt(node->body);
+    now_loop_count = outer_count;
+    loop_depth = outer_depth;
+
+    emit("%s:\n", end_label);
+}
+
+/*
+ * ベクトル化したループ (vectorize.c)
+ *
+ * 不変式はループの前に計算してxmm8から順に全ての要素へ複製しておき、
+ * 式の途中結果はxmm0から順に使う。配列の要素のアドレスは通常のコード生成で求める。
+ */
+
+static Vector *vector_invariants;  // 複製済みの不変式 (i番目はxmm(8+i))
+
+static char *vector_suffix(int size) {
+    if (size == 1) return "b";
+    if (size == 2) return "w";
+    if (size == 4) return "d";
+    return "q";
+}
+
+static bool has_deref(Node *node) {
+    if (node == NULL) return false;
+    if (node->kind == ND_DEREF) return true;
+    if (node->stmts) {
+        for (int i = 0; i < node->stmts->len; i++) {
+            if (has_deref(node->stmts->body[i])) return true;
+        }
+    }
+    return has_deref(node->lhs) || has_deref(node->rhs);
+}
+
+// 本体の式から不変式 (配列を読まない部分式) を集める
+static void collect_vector_invariants(Node *node) {
+    if (node == NULL) return;
+    node = unwrap_suger(node);
+    if (!has_deref(node)) {
+        vec_union1(vector_invariants, node);
+        return;
+    }
+    if (node->kind == ND_DEREF) return;
+    collect_vector_invariants(node->lhs);
+    if (node->kind != ND_LSHIFT) {
+        collect_vector_invariants(node->rhs);
+    }
+}
+
+// raxの値をxmmレジスタの全ての要素に複製する
+static void gen_broadcast(int xmm, int size) {
+    if (size == 8) {
+        emit("  movq xmm%d, rax\n", xmm);
+        emit("  punpcklqdq xmm%d, xmm%d\n", xmm, xmm);
+        return;
+    }
+
+    emit("  movd xmm%d, eax\n", xmm);
+    if (size == 1) {
+        emit("  punpcklbw xmm%d, xmm%d\n", xmm, xmm);
+    }
+    if (size <= 2) {
+        emit("  punpcklwd xmm%d, xmm%d\n", xmm, xmm);
+    }
+    emit("  pshufd xmm%d, xmm%d, 0\n", xmm, xmm);
+}
+
+// 式を計算し、結果を入れたxmmレジスタの番号を返す
+// 不変式は複製済みのレジスタをそのまま返す
+static int gen_vector_expr(Node *node, int xmm, int size) {
+    node = unwrap_suger(node);
+    for (int i = 0; i < vector_invariants->len; i++) {
+        if (vector_invariants->body[i] == node) {
+            return 8 + i;
+        }
+    }
+
+    if (node->kind == ND_CAST) {
+        return gen_vector_expr(node->lhs, xmm, size);
+    }
+
+    if (node->kind == ND_DEREF) {
+        gen(node->lhs);
+        pop();
+        emit("  movdqu xmm%d, [rax]\n", xmm);
+        return xmm;
+    }
+
+    int lhs = gen_vector_expr(node->lhs, xmm, size);
+    if (lhs != xmm) {
+        emit("  movdqa xmm%d, xmm%d\n", xmm, lhs);
+    }
+    if (node->kind == ND_LSHIFT) {
+        emit("  psll%s xmm%d, %ld\n", vector_suffix(size), xmm, unwrap_suger(node->rhs)->val);
+        return xmm;
+    }
+
+    int rhs = gen_vector_expr(node->rhs, xmm + 1, size);
+    if (node->kind == ND_ADD) {
+        emit("  padd%s xmm%d, xmm%d\n", vector_suffix(size), xmm, rhs);
+    } else if (node->kind == ND_SUB) {
+        emit("  psub%s xmm%d, xmm%d\n", vector_suffix(size), xmm, rhs);
+    } else if (node->kind == ND_MUL) {
+        emit("  pmullw xmm%d, xmm%d\n", xmm, rhs);
+    } else if (node->kind == ND_AND) {
+        emit("  pand xmm%d, xmm%d\n", xmm, rhs);
+    } else if (node->kind == ND_OR) {
+        emit("  por xmm%d, xmm%d\n", xmm, rhs);
+    } else if (node->kind == ND_XOR) {
+        emit("  pxor xmm%d, xmm%d\n", xmm, rhs);
+    } else {
+        error("gen_vector_expr() failure: ベクトル化できない演算です [%d]", node->kind);
+    }
+    return xmm;
+}
+
+static void gen_vector_loop(Node *node) {
+    int count = label_loop_count++;
+    int size = node->val;
+
+    vector_invariants = new_vec();
+    for (int i = 0; i < node->stmts->len; i++) {
+        Node *assign = node->stmts->body[i];
+        collect_vector_invariants(assign->rhs);
+    }
+    for (int i = 0; i < vector_invariants->len; i++) {
+        gen(vector_invariants->body[i]);
+        pop();
+        gen_broadcast(8 + i, size);
+    }
+
+    emit(".Lvector%04d:\n", count);
+    gen_branch(node->cond, false, format(".Lvectorend%04d", count));
+    for (int i = 0; i < node->stmts->len; i++) {
+        Node *assign = node->stmts->body[i];
+        int xmm = gen_vector_expr(assign->rhs, 0, size);
+        gen(unwrap_suger(assign->lhs)->lhs);
+        pop();
+        emit("  movdqu [rax], xmm%d\n", xmm);
+    }
+    gen_stmt(node->inc);
+    emit("  jmp .Lvector%04d\n", count);
+    emit(".Lvectorend%04d:\n", count);
+}
+
+// valを大きさsizeの符号付き整数に切り詰める
+static long trunc_to_size(long val, int size) {
+    if (size == 1) return (char)val;
+    if (size == 2) return (short)val;
+    if (size == 4) return (int)val;
+    return val;
+}
+
+// need_valueが偽なら代入した値を積まない
+static void gen_assign(Node *node, bool need_value) {
+    add_type(node->lhs);
+    long val;
+    bool is_imm = opt_level >= 1 && !need_value && node->lhs->type->kind != TYPE_STRUCT && eval_const(node->rhs, &val);
+    if (is_imm) {
+        // 定数の代入は即値をそのまま書きこむ
+        val = trunc_to_size(val, node->lhs->type->size);
+    }
+
+    if (node->lhs->kind == ND_VAR && node->lhs->var->reg) {
+        if (is_imm) {
+            emit("  mov %s, %ld\n", reg_name(node->lhs->var->reg), val);
+            return;
+        }
+        gen(node->rhs);
+        pop_rdi();
+        store_reg(node->lhs->var);
+        if (need_value) push_rdi();
+        return;
+    }
+
+    Addr am;
+    if (is_imm && is_imm32(val) && match_mem(node->lhs, &am)) {
+        gen_addr_parts(&am);
+        pop_addr_parts(&am);
+        emit("  mov %s PTR %s, %ld\n", word_ptr(node->lhs->type->size), addr_operand(&am), val);
+        return;
+    }
+    if (node->type->kind != TYPE_STRUCT && match_mem(node->lhs, &am)) {
+        gen_addr_parts(&am);
+        gen(node->rhs);
+        pop_rdi();
+        pop_addr_parts(&am);
+        char *mem = addr_operand(&am);
+        emit("  mov %s PTR %s, %s\n", word_ptr(node->lhs->type->size), mem, proper_register(node->lhs->type, REG_RDI));
+        if (need_value) push_rdi();
+        return;
+    }
+
+    gen_addr(node->lhs);
+    gen(node->rhs);
+    pop_rdi();
+    pop();
+    if (node->type->kind == TYPE_STRUCT) {
+        gen_struct_copy(node->type->size);
+    } else {
+        emit("  mov [rax], %s\n", proper_register(node->lhs->type, REG_RDI));
+    }
+
+    if (need_value) push_rdi();
+}
+
+// メモリに直接演算できる複合代入の命令
+static char *rmw_insn(NodeKind kind) {
+    switch (kind) {
+        case ND_ADD: return "add";
+        case ND_SUB: return "sub";
+        case ND_AND: return "and";
+        case ND_OR: return "or";
+        case ND_XOR: return "xor";
+        default: return NULL;
+    }
+}
+
+// メモリにある変数の位置 (アドレスを計算せずにオペランドに書ける)
+static char *var_mem(Var *var) {
+    if (var->is_global) {
+        return format("[rip+%s]", var->name);
+    }
+    return frame_slot(var->offset);
+}
+
+/*
+ * 複合代入と++ --
+ *
+ * 左辺のアドレスは一度だけ求め、メモリやレジスタに直接演算する。
+ *
+ * a[i] += x  →  add DWORD PTR [rax], edi
+ * i++        →  add DWORD PTR [rbp-8], 1  (レジスタに割り当てた変数なら add rbx, 1)
+ *
+ * 後置の++ --は書き換える前の値を、それ以外は書き換えた後の値を積む (need_valueが偽なら何も積まない)。
+ * 乗除算やシフトは直接演算できないので、右辺をそのまま計算して代入する。
+ */
+static void gen_assign_op(Node *node, bool need_value) {
+    Node *lhs = node->lhs;
+    add_type(lhs);
+    bool is_post = node->kind == ND_POST_INCDEC;
+    Node *x = assign_op_operand(node);
+    char *insn = x ? rmw_insn(node->rhs->kind) : NULL;
+    long val;
+    bool is_imm = x && eval_const(x, &val) && is_imm32(val);
+    if (!insn || !(is_integertype(lhs->type->kind) || lhs->type->kind == TYPE_PTR) || (is_post && !is_imm)) {
+        if (is_post && need_value) {
+            gen(lhs);
+            gen_assign(node, false);
+        } else {
+            gen_assign(node, need_value);
+        }
+        return;
+    }
+
+    if (!is_imm) {
+        gen(x);
+    }
+
+    if (lhs->kind == ND_VAR && lhs->var->reg) {
+        char *reg = reg_name(lhs->var->reg);
+        if (!is_imm) pop_rdi();
+        if (is_post && need_value) emit("  mov rax, %s\n", reg);
+        if (lhs->type->size == 8) {
+            emit("  %s %s, %s\n", insn, reg, is_imm ? format("%ld", val) : "rdi");
+        } else {
+            // 変数の型の幅で符号拡張し直す
+            if (is_imm) {
+                emit("  mov rdi, %s\n", reg);
+                emit("  %s rdi, %ld\n", insn, val);
+            } else if (node->rhs->kind == ND_SUB) {
+                emit("  neg rdi\n");
+                emit("  add rdi, %s\n", reg);
+            } else {
+                emit("  %s rdi, %s\n", insn, reg);
+            }
+            store_reg(lhs->var);
+        }
+        if (!is_post && need_value) {
+            emit("  mov rax, %s\n", reg);
+        }
+        if (need_value) push();
+        return;
+    }
+
+    char *mem = "[rax]";
+    Addr am;
+    if (match_mem(lhs, &am)) {
+        gen_addr_parts(&am);
+        pop_addr_parts(&am);
+        if (!is_imm) pop_rdi();
+        mem = addr_operand(&am);
+    } else if (lhs->kind == ND_VAR) {
+        if (!is_imm) pop_rdi();
+        mem = var_mem(lhs->var);
+    } else {
+        gen_addr(lhs);
+        pop();
+        if (!is_imm) pop_rdi();
+    }
+
+    char *ptr = word_ptr(lhs->type->size);
+    char *src = is_imm ? format("%ld", val) : proper_register(lhs->type, REG_RDI);
+    if (is_post && need_value) {
+        // 読みこむとraxが変わるので、アドレスにraxを使っていればrdiに移す
+        if (strstr(mem, "rax")) {
+            emit("  lea rdi, %s\n", mem);
+            mem = "[rdi]";
+        }
+        load_mem(lhs->type, "rax", mem);
+        emit("  %s %s PTR %s, %s\n", insn, ptr, mem, src);
+        push();
+        return;
+    }
+
+    emit("  %s %s PTR %s, %s\n", insn, ptr, mem, src);
+    if (!need_value) return;
+    load_mem(lhs->type, "rax", mem);
+    push();
+}
+
+// 値を持たない文 (値を使う場所では数合わせに一つ積む)
+static bool is_stmt_node(Node *node) {
+    switch (node->kind) {
+        case ND_RETURN:
+        case ND_IF:
+        case ND_WHILE:
+        case ND_FOR:
+        case ND_VECTOR_LOOP:
+        case ND_ZERO_FILL:
+        case ND_TEMPLATE_COPY:
+        case ND_SWITCH:
+        case ND_BREAK:
+        case ND_CONTINUE:
+            return true;
+        default:
+            return false;
+    }
 }
 
-static void push_num(long num) {
-    printf("  mov rax, %ld\n", num);
-    printf("  push rax\n");
+// 後続のコードに到達しない文
+static bool is_jump_node(Node *node) {
+    return node->kind == ND_RETURN || node->kind == ND_BREAK || node->kind == ND_CONTINUE;
 }
 
-static void pop() {
-    printf("  pop rax\n");
+// 最後の文が後続のコードに到達しない文で終わるか (値は数合わせで数えただけで積まれていない)
+static bool ends_with_jump(Node *node) {
+    if (is_jump_node(node)) return true;
+    if (node->kind == ND_CASE || node->kind == ND_DEFAULT) return ends_with_jump(node->lhs);
+    if (node->kind == ND_BLOCK || node->kind == ND_STMT_EXPR || node->kind == ND_SUGER) {
+        return node->stmts->len > 0 && ends_with_jump(vec_last(node->stmts));
+    }
+    return false;
 }
 
-static void pop_rdi() {
-    printf("  pop rdi\n");
+// 関数本体の値をraxに下ろす (ジャンプで終わるなら何も積まれていないので数だけ戻す)
+static void pop_result() {
+    if (ends_with_jump(current_fn->body)) {
+        depth--;
+    } else {
+        pop();
+    }
 }
 
-static void assign_lvar_offsets() {
-    for (int i = 0; i < funcs->len; i++) {
-        Function *fn = funcs->body[i];
-        if (fn->locals->next_offset > 0) {
-            fn->stack_size = fn->locals->next_offset;
-        } else {
-            fn->stack_size = fn->locals->offset;
-        }
+// 関数を呼び出す (返り値はraxに残り、スタックには何も積まない)
+static void gen_call(Node *node) {
+    if (strcmp(node->fn_name, "va_start") == 0) {
+        /*
+         * va_startをマクロとして実装できないので、内部で va_start(ap, fmt)を
+         * *ap = *(struct __builtin_va_list *)__va_area__
+         * に置換する。
+         */
+        gen_stmt(node->lhs);
+        return;
     }
-}
 
-// 左辺値は変数である必要がある
-// ローカル変数のアドレスを生成
-static void gen_lval(Node *node) {
-    if (node->kind != ND_VAR) {
-        error("代入の左辺値が変数ではありません");
+    // 呼び出しで壊れるキャッシュのレジスタの値は、引数を計算する前に積んでおく
+    flush_cache();
+    gen_call_args(node);
+
+    // 可変長引数の関数にはベクタレジスタの個数をalで渡す
+    Function *callee = find_func(node->fn_name);
+    if (callee == NULL || callee->is_variadic) {
+        emit("  mov rax, 0\n");
     }
 
-    if (node->var->is_global) {
-        printf("  lea rax, [rip+%s]\n", node->var->name);
-    } else {
-        printf("  mov rax, rbp\n");
-        printf("  sub rax, %d\n", node->var->offset);
+    // rspを16の倍数にアライメントしてからコールする
+    if (depth % 2) {
+        emit("  sub rsp, 8\n");
+    }
+    emit("  call %s\n", node->fn_name);
+    if (depth % 2) {
+        emit("  add rsp, 8\n");
     }
+}
 
-    push();
+// インライン展開した関数の引数の代入と本体 (返り値の一時変数は読まない)
+static void gen_inline_body(Node *node) {
+    for (int i = 0; i < node->stmts->len; i++) {
+        gen_stmt(node->stmts->body[i]);
+    }
+
+    int outer_depth = inline_depth;
+    inline_depth = depth;
+    gen_stmt(node->body);
+    inline_depth = outer_depth;
+    emit(".Linlineend%04ld:\n", node->val);
 }
 
-// ポインター変数への代入への対応
-static void gen_addr(Node *node) {
-    if (node->kind == ND_DEREF) {
-        gen(node->lhs);
+/*
+ * 値を使わない文や式
+ *
+ * スタックには何も積まずに戻る。代入は代入した値を、関数呼び出しは返り値を積まない。
+ * break, continue, returnは飛んだ後のdepthをそのままにする。
+ */
+static void gen_stmt(Node *node) {
+    // 入れ子ループに対応するためにローカル変数で深さを持つ
+    int loop_count = label_loop_count;
+    int if_count = label_if_count;
+
+    // 文はラベルやジャンプを含むので、式の途中の値はスタックに書き出しておく
+    flush_cache();
+    if (node->kind == ND_NULL) {
         return;
-    } else if (node->kind == ND_VAR) {
-        gen_lval(node);
+    } else if (node->kind == ND_ASSIGN) {
+        gen_assign(node, false);
         return;
-    } else if (node->kind == ND_ADD || node->kind == ND_SUB) {
-        gen(node);
+    } else if (node->kind == ND_ASSIGN_OP || node->kind == ND_POST_INCDEC) {
+        gen_assign_op(node, false);
         return;
-    } else if (node->kind == ND_STRUCT_MEMBER) {
-        gen_addr(node->lhs);
-        pop();
-        printf("  add rax, %ld\n", node->val);
-        push();
+    } else if (node->kind == ND_RETURN && node->val) {
+        // インライン展開した関数のreturn (返り値は展開時に一時変数への代入にしてある)
+        gen_stmt(node->lhs);
+        unwind_to(inline_depth);
+        emit("  jmp .Linlineend%04ld\n", node->val);
         return;
-    } else if (node->kind == ND_TERNARY) {
-        gen(node);
+    } else if (node->kind == ND_RETURN && is_tail_call(unwrap_suger(node->lhs))) {
+        gen_tail_call(unwrap_suger(node->lhs));
         return;
-    } else if (node->kind == ND_SUGER || node->kind == ND_STMT_EXPR) {
-        gen(node);
+    } else if (node->kind == ND_RETURN) {
+        gen(node->lhs);
+        pop_rdi();
+        if (current_fn->ret_type->kind == TYPE_CHAR) {
+            emit("  movsx rax, dil\n");
+        } else if (current_fn->ret_type->kind != TYPE_VOID) {
+            if (current_fn->ret_type->size < 8) {
+                emit("  movsx rax, %s\n", proper_register(current_fn->ret_type, REG_RDI));
+            } else if (current_fn->ret_type->size == 8) {
+                emit("  mov rax, rdi\n");
+            } else {
+                error("gen_stmt() failure: ND_RETURN can't return over 8 size.");
+            }
+        }
+
+        if (current_fn->omit_frame_pointer) {
+            unwind_to(0);
+        }
+        // rbpがあればエピローグでrspを戻すので、ここでスタックを片付ける必要はない
+        emit("  jmp .L.return.%s\n", current_fn->name);
         return;
-    }
+    } else if (node->kind == ND_IF || node->kind == ND_TERNARY) {
+        label_if_count++;
+        if (node->els) {
+            gen_branch(node->cond, false, format(".Lifelse%04d", if_count));
+            gen_stmt(node->then);
+            emit("  jmp .Lifend%04d\n", if_count);
+            emit(".Lifelse%04d:\n", if_count);
+            gen_stmt(node->els);
+        } else {
+            gen_branch(node->cond, false, format(".Lifend%04d", if_count));
+            gen_stmt(node->then);
+        }
+        emit(".Lifend%04d:\n", if_count);
+        return;
+    } else if (node->kind == ND_WHILE) {
+        label_loop_count++;
+        emit(".Lloopbegin%04d:\n", loop_count);
+        gen_branch(node->cond, false, format(".Lloopend%04d", loop_count));
 
-    error("左辺値がポインターまたは変数ではありません");
-}
+        gen_loop_body(node->body, loop_count);
 
-static void load(Type *ty) {
-    if (ty->kind == TYPE_ARRAY || ty->kind == TYPE_STRUCT) {
-        // アドレスのまま読みこむようにする
+        // whileには必要ないが、for文との辻褄合わせに入れる
+        emit(".Lloopinc%04d:\n", loop_count);
+        emit("  jmp .Lloopbegin%04d\n", loop_count);
+        emit(".Lloopend%04d:\n", loop_count);
         return;
-    }
+    } else if (node->kind == ND_FOR) {
+        label_loop_count++;
+        if (node->init) {
+            gen_stmt(node->init);
+        }
+        emit(".Lloopbegin%04d:\n", loop_count);
+        if (node->cond) {
+            gen_branch(node->cond, false, format(".Lloopend%04d", loop_count));
+        }
+
+        gen_loop_body(node->body, loop_count);
 
-    if (ty->kind == TYPE_CHAR) {
-        printf("  movsx eax, BYTE PTR [rax]\n");
+        emit(".Lloopinc%04d:\n", loop_count);
+        if (node->inc) {
+            gen_stmt(node->inc);
+        }
+        emit("  jmp .Lloopbegin%04d\n", loop_count);
+        emit(".Lloopend%04d:\n", loop_count);
+        return;
+    } else if (node->kind == ND_VECTOR_LOOP) {
+        gen_vector_loop(node);
+        return;
+    } else if (node->kind == ND_ZERO_FILL) {
+        gen_addr(node->lhs);
+        pop();
+        if (node->val) {
+            emit("  add rax, %ld\n", node->val);
+        }
+        gen_zero_fill(node->lhs->var->type->size - node->val);
+        return;
+    } else if (node->kind == ND_TEMPLATE_COPY) {
+        gen_addr(node->lhs);
+        pop();
+        emit("  lea rdi, [rip+%s]\n", template_label(node));
+        gen_struct_copy(node->val);
+        return;
+    } else if (node->kind == ND_SWITCH) {
+        gen_switch(node);
+        return;
+    } else if (node->kind == ND_CASE || node->kind == ND_DEFAULT) {
+        // 続けて書かれたcaseは同じラベルを共有し、最後のcaseがラベルを出力する
+        if (!is_case_node(node->lhs)) {
+            emit("%s:\n", case_label(node));
+        }
+        gen_stmt(node->lhs);
+        return;
+    } else if (node->kind == ND_BREAK) {
+        // loop_countは次の深さになっているので１を引く
+        if (now_loop_count - 1 < 0) {
+            error("forブロックの中でbreakを使用していません。");
+        }
+        unwind_to(loop_depth);
+        emit("  jmp .Lloopend%04d\n", now_loop_count - 1);
+        return;
+    } else if (node->kind == ND_CONTINUE) {
+        if (continue_count - 1 < 0) {
+            error("forブロックの中でcontinueを使用していません。");
+        }
+        unwind_to(continue_depth);
+        emit("  jmp .Lloopinc%04d\n", continue_count - 1);
+        return;
+    } else if (node->kind == ND_BLOCK || node->kind == ND_STMT_EXPR || node->kind == ND_SUGER) {
+        for (int i = 0; i < node->stmts->len; i++) {
+            gen_stmt(node->stmts->body[i]);
+        }
+        return;
+    } else if (node->kind == ND_INLINE) {
+        gen_inline_body(node);
+        return;
+    } else if (node->kind == ND_CALL) {
+        gen_call(node);
         return;
     }
 
-    printf("  mov %s, [rax]\n", proper_register(ty, REG_RAX));
-
-    if (ty->size == 4) {
-        printf("  cdqe\n");
-    } else if (ty->size == 2) {
-        printf("  cwde\n");
-    } else if (ty->size == 1) {
-        printf("  cbw\n");
-    }
+    gen(node);
+    pop();
 }
 
 static void gen(Node *node) {
-    // 入れ子ループに対応するためにローカル変数で深さを持つ
-    int loop_count = label_loop_count;  // ループカウントの一時保存にも使う
     int if_count = label_if_count;
 
     if (node->kind == ND_NULL) {
@@ -199,16 +2400,23 @@ static void gen(Node *node) {
         push_num(node->val);
         return;
     } else if (node->kind == ND_STRING) {
-        printf("  lea rax, [rip+.LC%ld]\n", node->val);
+        emit("  lea rax, [rip+.LC%ld]\n", node->val);
         push();
         return;
     } else if (node->kind == ND_STRUCT_MEMBER) {
+        if (gen_load(node)) return;
         gen_addr(node);
         pop();
         load(node->type);
         push();
         return;
     } else if (node->kind == ND_VAR) {
+        if (node->var->reg) {
+            emit("  mov rax, %s\n", reg_name(node->var->reg));
+            push();
+            return;
+        }
+        if (gen_load(node)) return;
         gen_lval(node);
         pop();
         add_type(node);
@@ -219,6 +2427,7 @@ static void gen(Node *node) {
         gen_addr(node->lhs);
         return;
     } else if (node->kind == ND_DEREF) {
+        if (gen_load(node)) return;
         gen(node->lhs);
         pop();
         add_type(node);
@@ -226,189 +2435,92 @@ static void gen(Node *node) {
         push();
         return;
     } else if (node->kind == ND_ASSIGN) {
-        gen_addr(node->lhs);
-        gen(node->rhs);
-        pop_rdi();
-        pop();
-        add_type(node->lhs);
-        if (node->type->kind == TYPE_STRUCT) {
-            // メモリコピー
-            for (int i = 0; i < node->type->size; i++) {
-                printf("  mov r8, [rdi+%d]\n", i);
-                printf("  mov [rax+%d], r8\n", i);
-            }
-        } else {
-            printf("  mov [rax], %s\n", proper_register(node->lhs->type, REG_RDI));
-        }
-
-        push_rdi();
+        gen_assign(node, true);
         return;
-    } else if (node->kind == ND_RETURN) {
-        gen(node->lhs);
-        pop_rdi();
-        if (current_fn->ret_type->kind == TYPE_CHAR) {
-            printf("  movsx rax, dil\n");
-        } else if (current_fn->ret_type->kind != TYPE_VOID) {
-            if (current_fn->ret_type->size < 8) {
-                printf("  movsx rax, %s\n", proper_register(current_fn->ret_type, REG_RDI));
-            } else if (current_fn->ret_type->size == 8) {
-                printf("  mov rax, rdi\n");
-            } else {
-                error("gen() failure: ND_RETURN can't return over 8 size.");
-            }
-        }
-
-        printf("  jmp .L.return.%s\n", current_fn->name);
-        // returnは終了なので数合わせなし
+    } else if (node->kind == ND_ASSIGN_OP || node->kind == ND_POST_INCDEC) {
+        gen_assign_op(node, true);
         return;
-    } else if (node->kind == ND_IF) {
-        label_if_count++;
-        gen(node->cond);
-        pop();
-        printf("  cmp rax, 0\n");
-        if (node->els) {
-            printf("  je  .Lifelse%04d\n", if_count);
-            gen(node->then);
-            printf("  jmp .Lifend%04d\n", if_count);
-            printf(".Lifelse%04d:\n", if_count);
-            gen(node->els);
-            printf(".Lifend%04d:\n", if_count);
+    } else if (is_stmt_node(node)) {
+        // 値を使う場所に置かれた文 (関数やブロックの最後の文)
+        gen_stmt(node);
+        if (is_jump_node(node)) {
+            depth++;  // 数合わせ (後続のコードには到達しない)
         } else {
-            printf("  je  .Lifend%04d\n", if_count);
-            gen(node->then);
-            pop();  // 数合わせ
-            printf(".Lifend%04d:\n", if_count);
             push();  // 数合わせ
         }
-
         return;
     } else if (node->kind == ND_TERNARY) {
         label_if_count++;
-        gen(node->cond);
-        pop();
-        printf("  cmp rax, 0\n");
-        printf("  je  .Lifelse%04d\n", if_count);
+        flush_cache();
+        gen_branch(node->cond, false, format(".Lifelse%04d", if_count));
+        int d = depth;
         gen(node->then);
-        printf("  jmp .Lifend%04d\n", if_count);
-        printf(".Lifelse%04d:\n", if_count);
+        flush_cache();
+        emit("  jmp .Lifend%04d\n", if_count);
+        emit(".Lifelse%04d:\n", if_count);
+        depth = d;
         gen(node->els);
-        printf(".Lifend%04d:\n", if_count);
-
-        return;
-    } else if (node->kind == ND_WHILE) {
-        label_loop_count++;
-        printf(".Lloopbegin%04d:\n", loop_count);
-        gen(node->cond);
-        pop();
-        printf("  cmp rax, 0\n");
-        printf("  je  .Lloopend%04d\n", loop_count);
-
-        // 次のループカウントにする
-        now_loop_count = label_loop_count;
-        gen(node->body);
-        // 元のループカウントに戻す
-        now_loop_count = loop_count;
-
-        // whileには必要ないが、for文との辻褄合わせに入れる
-        printf(".Lloopinc%04d:\n", loop_count);
-        printf("  jmp .Lloopbegin%04d\n", loop_count);
-        printf(".Lloopend%04d:\n", loop_count);
-        return;
-    } else if (node->kind == ND_FOR) {
-        label_loop_count++;
-        if (node->init) {
-            gen(node->init);
-        }
-        printf(".Lloopbegin%04d:\n", loop_count);
-        if (node->cond) {
-            gen(node->cond);
-            pop();
-            printf("  cmp rax, 0\n");
-            printf("  je  .Lloopend%04d\n", loop_count);
-        }
-
-        now_loop_count = label_loop_count;
-        gen(node->body);
-        now_loop_count = loop_count;
+        flush_cache();
+        emit(".Lifend%04d:\n", if_count);
 
-        printf(".Lloopinc%04d:\n", loop_count);
-        if (node->inc) {
-            gen(node->inc);
-        }
-        printf("  jmp .Lloopbegin%04d\n", loop_count);
-        printf(".Lloopend%04d:\n", loop_count);
         return;
-    } else if (node->kind == ND_BREAK) {
-        // loop_countは次の深さになっているので１を引く
-        if (now_loop_count - 1 < 0) {
-            error("forブロックの中でbreakを使用していません。");
+    } else if (node->kind == ND_CASE || node->kind == ND_DEFAULT) {
+        if (!is_case_node(node->lhs)) {
+            flush_cache();
+            emit("%s:\n", case_label(node));
         }
-        push();  // 数合わせ
-        printf("  jmp .Lloopend%04d\n", now_loop_count - 1);
+        gen(node->lhs);
         return;
-    } else if (node->kind == ND_CONTINUE) {
-        // loop_countは次の深さになっているので１を引く
-        if (now_loop_count - 1 < 0) {
-            error("forブロックの中でbreakを使用していません。");
+    } else if (node->kind == ND_BLOCK || node->kind == ND_STMT_EXPR || node->kind == ND_SUGER) {
+        // 最後の文の値を積む
+        if (node->stmts->len == 0) {
+            push();  // 数合わせ
+            return;
         }
-        push();  // 数合わせ
-        printf("  jmp .Lloopinc%04d\n", now_loop_count - 1);
-        return;
-    } else if (node->kind == ND_BLOCK || node->kind == ND_STMT_EXPR) {
-        for (int i = 0; i < node->stmts->len; i++) {
-            gen(node->stmts->body[i]);
-            pop();
+        for (int i = 0; i < node->stmts->len - 1; i++) {
+            gen_stmt(node->stmts->body[i]);
         }
-        push();  // 数合わせ
+        gen(vec_last(node->stmts));
         return;
-    } else if (node->kind == ND_SUGER) {
-        for (int i = 0; i < node->stmts->len; i++) {
-            gen(node->stmts->body[i]);
-            pop();
+    } else if (node->kind == ND_INLINE) {
+        gen_inline_body(node);
+        if (node->lhs) {
+            gen(node->lhs);
+        } else {
+            push();  // 数合わせ
         }
-        push();  // 数合わせ
         return;
     } else if (node->kind == ND_CALL) {
-        if (strcmp(node->fn_name, "va_start") == 0) {
-            /*
-             * va_startをマクロとして実装できないので、内部で va_start(ap, fmt)を
-             * *ap = *(struct __builtin_va_list *)__va_area__
-             * に置換する。
-             */
-            gen(node->lhs);
-            return;
-        }
-
-        int nargs = node->args->len;
-        for (int i = 0; i < nargs; i++) {
-            gen(node->args->body[i]);
-        }
-        for (int i = nargs - 1; i >= 0; i--) {
-            Var *l = node->args->body[i];
-            printf("  pop %s\n", argreg64[i]);
-        }
-        // rspを16の倍数にアライメントしてからコールする
-        printf("  mov rax, 0\n");
-        printf("  push rbp\n");
-        printf("  mov rbp, rsp\n");
-        printf("  and rsp, -16\n");
-        printf("  call %s\n", node->fn_name);
-        printf("  mov rsp, rbp\n");
-        printf("  pop rbp\n");
-        push();  // 数合わせ
+        gen_call(node);
+        push();
         return;
     } else if (node->kind == ND_LOGICALNOT) {
         gen(node->lhs);
         pop();
-        printf("  test rax, rax\n");
-        printf("  sete al\n");
-        printf("  movzb rax, al\n");
+        emit("  test rax, rax\n");
+        emit("  sete al\n");
+        emit("  movzb rax, al\n");
         push();
         return;
+    } else if (node->kind == ND_LOGICAL_AND || node->kind == ND_LOGICAL_OR) {
+        // 分岐で評価し、それぞれの行き先で0か1を積む
+        int count = label_logical_count++;
+        flush_cache();
+        gen_branch(node, false, format(".Llogical%04d", count));
+        int d = depth;
+        push_num(1);
+        flush_cache();
+        emit("  jmp .Llogicalend%04d\n", count);
+        emit(".Llogical%04d:\n", count);
+        depth = d;
+        push_num(0);
+        flush_cache();
+        emit(".Llogicalend%04d:\n", count);
+        return;
     } else if (node->kind == ND_NOT) {
         gen(node->lhs);
         pop();
-        printf("  not rax\n");
+        emit("  not rax\n");
         push();
         return;
     } else if (node->kind == ND_CAST) {
@@ -418,156 +2530,245 @@ static void gen(Node *node) {
             // キャストの必要なし
         } else if (node->type->size == 4) {
             // 4byteだと命令が異なる
-            printf("  movsxd rax, eax\n");
+            emit("  movsxd rax, eax\n");
         } else {
-            printf("  movsx rax, %s\n", proper_register(node->type, REG_RAX));
+            emit("  movsx rax, %s\n", proper_register(node->type, REG_RAX));
         }
         push();
         return;
     }
 
-    // 主に演算のATSで読みこまれる
-    gen(node->lhs);
-    gen(node->rhs);
+    // 定数との乗除算はシフトや掛け算に置き換える
+    if (gen_strength_reduced(node)) {
+        return;
+    }
+    if (gen_add_lea(node) || gen_binary_simple(node)) {
+        return;
+    }
 
-    pop_rdi();
-    pop();
+    // 主に演算のATSで読みこまれる
+    gen_operands(node->lhs, node->rhs);
 
     if (node->kind == ND_ADD) {
-        printf("  add rax, rdi\n");
+        emit("  add rax, rdi\n");
     } else if (node->kind == ND_SUB) {
-        printf("  sub rax, rdi\n");
+        emit("  sub rax, rdi\n");
     } else if (node->kind == ND_MUL) {
-        printf("  imul rax, rdi\n");
+        emit("  imul rax, rdi\n");
+    } else if ((node->kind == ND_DIV || node->kind == ND_MOD) && is_int_div(node)) {
+        emit("  cdq\n");
+        emit("  idiv edi\n");
+        emit("  movsxd rax, %s\n", node->kind == ND_DIV ? "eax" : "edx");
     } else if (node->kind == ND_DIV) {
-        printf("  cqo\n");
-        printf("  idiv rdi\n");
+        emit("  cqo\n");
+        emit("  idiv rdi\n");
     } else if (node->kind == ND_MOD) {
-        printf("  cqo\n");
-        printf("  idiv rdi\n");
-        printf("  mov rax, rdx\n");
+        emit("  cqo\n");
+        emit("  idiv rdi\n");
+        emit("  mov rax, rdx\n");
     } else if (node->kind == ND_EQ) {
-        printf("  cmp rax, rdi\n");
-        printf("  sete al\n");
-        printf("  movzb rax, al\n");
+        emit("  cmp rax, rdi\n");
+        emit("  sete al\n");
+        emit("  movzb rax, al\n");
     } else if (node->kind == ND_NE) {
-        printf("  cmp rax, rdi\n");
-        printf("  setne al\n");
-        printf("  movzb rax, al\n");
+        emit("  cmp rax, rdi\n");
+        emit("  setne al\n");
+        emit("  movzb rax, al\n");
     } else if (node->kind == ND_LT) {
-        printf("  cmp rax, rdi\n");
-        printf("  setl al\n");
-        printf("  movzb rax, al\n");
+        emit("  cmp rax, rdi\n");
+        emit("  setl al\n");
+        emit("  movzb rax, al\n");
     } else if (node->kind == ND_LE) {
-        printf("  cmp rax, rdi\n");
-        printf("  setle al\n");
-        printf("  movzb rax, al\n");
-    } else if (node->kind == ND_LOGICAL_AND) {
-        printf("  cmp rax, 0\n");
-        printf("  setne al\n");
-        printf("  movzb rax, al\n");
-        printf("  cmp rdi, 0\n");
-        printf("  setne dil\n");
-        printf("  movzb rdi, dil\n");
-        printf("  and rax, rdi\n");
-    } else if (node->kind == ND_LOGICAL_OR) {
-        printf("  cmp rax, 0\n");
-        printf("  setne al\n");
-        printf("  movzb rax, al\n");
-        printf("  cmp rdi, 0\n");
-        printf("  setne dil\n");
-        printf("  movzb rdi, dil\n");
-        printf("  or rax, rdi\n");
+        emit("  cmp rax, rdi\n");
+        emit("  setle al\n");
+        emit("  movzb rax, al\n");
     } else if (node->kind == ND_AND) {
-        printf("  and rax, rdi\n");
+        emit("  and rax, rdi\n");
     } else if (node->kind == ND_OR) {
-        printf("  or rax, rdi\n");
+        emit("  or rax, rdi\n");
     } else if (node->kind == ND_XOR) {
-        printf("  xor rax, rdi\n");
+        emit("  xor rax, rdi\n");
     } else if (node->kind == ND_LSHIFT) {
-        printf("  mov rcx, rdi\n");
-        printf("  sal rax, cl\n");
+        emit("  mov rcx, rdi\n");
+        emit("  sal rax, cl\n");
     } else if (node->kind == ND_RSHIFT) {
-        printf("  mov rcx, rdi\n");
-        printf("  sar rax, cl\n");
+        emit("  mov rcx, rdi\n");
+        emit("  sar rax, cl\n");
     }
 
     push();
 }
 
-void codegen() {
-    // プロトタイプ関数を削除
-    delete_prototype_func();
-
-    // 各関数のoffsetを計算
-    assign_lvar_offsets();
+static bool has_call(Node *node) {
+    if (node == NULL) return false;
+    if (node->kind == ND_CALL) return true;
+    if (has_call(node->lhs) || has_call(node->rhs) || has_call(node->cond) || has_call(node->then)) return true;
+    if (has_call(node->els) || has_call(node->body) || has_call(node->init) || has_call(node->inc)) return true;
+    for (int i = 0; node->args && i < node->args->len; i++) {
+        if (has_call(node->args->body[i])) return true;
+    }
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) {
+        if (has_call(node->stmts->body[i])) return true;
+    }
+    return false;
+}
 
-    // アセンブリの前半部分を出力
-    printf(".intel_syntax noprefix\n");
+/*
+ * rbpを使わないスタックフレームの配置を決める
+ *
+ * 通常はrbpをpushする代わりに8バイト余分に引いて、プロローグ後のrspを16の倍数にする。
+ * 関数を呼ばない関数 (リーフ関数) は、ローカル変数と式の評価に使うスタックが
+ * レッドゾーン (rspより下の128バイト) に収まればrspを動かさない。このとき
+ * ローカル変数は式の評価で積む値と重ならないように、その下に置く。
+ */
+static void layout_frame() {
+    frame_size = current_fn->stack_size + 8;
+    frame_base = current_fn->stack_size;
+    if (has_call(current_fn->body)) {
+        return;
+    }
 
-    printf(".data\n");
+    // 本体を一度生成してスタックの最大の深さを求める (生成したコードは捨てる)
+    int len = code->len;
+    depth = max_depth = 0;
+    gen(current_fn->body);
+    pop_result();
+    code->len = len;
 
-    // 文字列リテラルの生成
-    for (int i = 0; i < string_literal->len; i++) {
-        Token *tok = (Token *)string_literal->body[i];
-        printf(".LC%d:\n", tok->str_literal_index);
-        printf("  .string \"%s\"\n", tok->str);
+    if (current_fn->stack_size + max_depth * 8 <= 128) {
+        frame_size = 0;
+        frame_base = -max_depth * 8;
     }
+}
 
-    // グローバル変数の生成
-    for (Var *var = globals; var != NULL; var = var->next) {
-        if (var->is_extern) continue;
+void codegen() {
+    // プロトタイプ関数を削除
+    delete_prototype_func();
 
-        printf("%s:\n", var->name);
-        // 宣言のみ
-        if (var->ginit->len == 0) {
-            printf("  .zero %d\n", var->type->size);
-            continue;
+    // ローカル変数のレジスタ割り当てと、残りの変数のスタック上の配置
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        // rbpを割り当て対象にするかどうかが決まるので、レジスタ割り当てより先に決める
+        fn->omit_frame_pointer = omit_frame_pointer && !fn->is_variadic;
+        if (opt_level >= 1) {
+            alloc_regs(fn);
+        } else {
+            fn->saved_regs = new_vec();
+            fn->cache_regs = new_vec();
         }
+        assign_lvar_offsets(fn);
+        // 退避用の領域をスタックに確保する
+        fn->stack_size += fn->saved_regs->len * 8;
+        // rspを16の倍数に保つ
+        fn->stack_size = (fn->stack_size + 15) / 16 * 16;
+    }
 
-        // 初期化式あり
-        for (int i = 0; i < var->ginit->len; i++) {
-            GInit_el *g = var->ginit->body[i];
+    code = new_vec();
+    templates = new_vec();
+    case_nodes = new_vec();
+    case_labels = new_vec();
 
-            // ポインターかラベル
-            if (g->str) {
-                printf("  .quad %s\n", g->str);
-                continue;
-            }
+    // アセンブリの前半部分を出力
+    emit(".intel_syntax noprefix\n");
 
-            int s = array_base_type_size(var->type);
-            if (s == 8) {
-                printf("  .quad %ld\n", g->val);
-            } else if (s == 4) {
-                printf("  .long %ld\n", g->val);
-            } else if (s == 2) {
-                printf("  .value %ld\n", g->val);
-            } else if (s == 1) {
-                printf("  .byte %ld\n", g->val);
+    // 文字列リテラルの生成
+    // 読み込み専用で、リンカが同じ内容の文字列をまとめられるセクションに置く
+    // 途中に\0を含むものはリンカが別の文字列として扱うので普通の.rodataに置く
+    for (int merge = 1; merge >= 0; merge--) {
+        bool has_section = false;
+        for (int i = 0; i < string_literal->len; i++) {
+            Token *tok = (Token *)string_literal->body[i];
+            if (has_embedded_nul(tok->str) == merge) continue;
+            if (!has_section) {
+                emit(merge ? ".section .rodata.str1.1,\"aMS\",@progbits,1\n" : ".section .rodata\n");
+                has_section = true;
             }
+            emit(".LC%d:\n", tok->str_literal_index);
+            emit("  .string \"%s\"\n", tok->str);
         }
     }
 
-    printf(".text\n");
+    emit(".data\n");
+
+    // 初期値のあるグローバル変数の生成
+    for (Var *var = globals; var != NULL; var = var->next) {
+        if (var->is_extern || var->is_typedef || is_zero_global(var)) continue;
+        gen_global_symbol(var);
+        gen_global(var);
+    }
+
+    // 0で初期化されるグローバル変数はバイナリに含めない
+    emit(".bss\n");
+    for (Var *var = globals; var != NULL; var = var->next) {
+        if (var->is_extern || var->is_typedef || !is_zero_global(var)) continue;
+        gen_global_symbol(var);
+        emit("  .align %d\n", alignOfType(var->type));
+        emit("%s:\n", var->name);
+        emit("  .zero %d\n", var->type->size);
+    }
+
+    emit(".text\n");
     // 先頭の式から順にコード生成
     for (int i = 0; i < funcs->len; i++) {
         current_fn = funcs->body[i];
-        printf(".globl %s\n", current_fn->name);
-        printf("%s:\n", current_fn->name);
+        if (!current_fn->is_static) {
+            emit(".globl %s\n", current_fn->name);
+        }
+        emit("%s:\n", current_fn->name);
+
+        can_tail_call = opt_level >= 1 && optimize_sibling_calls && !current_fn->va_area &&
+                        !has_escaped_local(current_fn->body);
+        cache_regs = current_fn->cache_regs;
+        cached = 0;
+        if (current_fn->omit_frame_pointer) {
+            layout_frame();
+        }
+        depth = 0;
 
         // プロローグ
-        printf("  push rbp\n");
-        printf("  mov rbp, rsp\n");
-        printf("  sub rsp, %d\n", current_fn->stack_size);
+        if (!current_fn->omit_frame_pointer) {
+            emit("  push rbp\n");
+            emit("  mov rbp, rsp\n");
+            if (current_fn->stack_size > 0) {
+                emit("  sub rsp, %d\n", current_fn->stack_size);
+            }
+        } else if (frame_size > 0) {
+            emit("  sub rsp, %d\n", frame_size);
+        }
+
+        // callee-savedレジスタはスタックフレームの末尾に退避する
+        for (int k = 0; k < current_fn->saved_regs->len; k++) {
+            emit("  mov %s, %s\n", frame_slot(current_fn->stack_size - k * 8), current_fn->saved_regs->body[k]);
+        }
+
+        // 自分自身の末尾呼び出しはここに戻る
+        emit(".L.tailcall.%s:\n", current_fn->name);
 
         int j = 0;
         for (Var *var = current_fn->params; var; var = var->next) {
-            printf("  mov rax, rbp\n");
-            printf("  sub rax, %d\n", var->offset);
+            if (var->lvar && var->lvar->reg) {
+                char *reg = reg_name(var->lvar->reg);
+                if (var->type->size == 8) {
+                    emit("  mov %s, %s\n", reg, argreg64[j]);
+                } else if (var->type->size == 4) {
+                    emit("  movsxd %s, %s\n", reg, argreg32[j]);
+                } else {
+                    emit("  movsx %s, %s\n", reg, get_argreg(j, var->type));
+                }
+                j++;
+                continue;
+            }
+
             Type *ty = var->type;
             if (var->type->kind == TYPE_ARRAY)
                 ty = new_ptr_type(var->type);
-            printf("  mov [rax], %s\n", get_argreg(j++, ty));
+            if (current_fn->omit_frame_pointer) {
+                emit("  mov %s, %s\n", frame_slot(var->offset), get_argreg(j++, ty));
+                continue;
+            }
+            emit("  mov rax, rbp\n");
+            emit("  sub rax, %d\n", var->offset);
+            emit("  mov [rax], %s\n", get_argreg(j++, ty));
         }
 
         if (current_fn->va_area) {
@@ -578,37 +2779,66 @@ void codegen() {
             int off = current_fn->va_area->offset;
 
             // __builtin_va_list
-            printf("  mov DWORD PTR [rbp-%d], %d\n", off - 0, gp * 8);  // gp
-            printf("  mov DWORD PTR [rbp-%d], 0\n", off - 4);           // fp
-            printf("  mov [rbp-%d], rbp\n", off - 16);                  // reg_save_area
-            printf("  sub QWORD PTR [rbp-%d], %d\n", off - 16, off - 24);
+            emit("  mov DWORD PTR [rbp-%d], %d\n", off - 0, gp * 8);  // gp
+            emit("  mov DWORD PTR [rbp-%d], 0\n", off - 4);           // fp
+            emit("  mov [rbp-%d], rbp\n", off - 16);                  // reg_save_area
+            emit("  sub QWORD PTR [rbp-%d], %d\n", off - 16, off - 24);
 
             // __va_save_area__
-            printf("  mov [rbp-%d], rdi\n", off - 24);
-            printf("  mov [rbp-%d], rsi\n", off - 32);
-            printf("  mov [rbp-%d], rdx\n", off - 40);
-            printf("  mov [rbp-%d], rcx\n", off - 48);
-            printf("  mov [rbp-%d], r8\n", off - 56);
-            printf("  mov [rbp-%d], r9\n", off - 64);
-            printf("  movsd [rbp-%d], xmm0\n", off - 72);
-            printf("  movsd [rbp-%d], xmm1\n", off - 80);
-            printf("  movsd [rbp-%d], xmm2\n", off - 88);
-            printf("  movsd [rbp-%d], xmm3\n", off - 96);
-            printf("  movsd [rbp-%d], xmm4\n", off - 104);
-            printf("  movsd [rbp-%d], xmm5\n", off - 112);
-            printf("  movsd [rbp-%d], xmm6\n", off - 120);
-            printf("  movsd [rbp-%d], xmm7\n", off - 128);
+            emit("  mov [rbp-%d], rdi\n", off - 24);
+            emit("  mov [rbp-%d], rsi\n", off - 32);
+            emit("  mov [rbp-%d], rdx\n", off - 40);
+            emit("  mov [rbp-%d], rcx\n", off - 48);
+            emit("  mov [rbp-%d], r8\n", off - 56);
+            emit("  mov [rbp-%d], r9\n", off - 64);
+            emit("  movsd [rbp-%d], xmm0\n", off - 72);
+            emit("  movsd [rbp-%d], xmm1\n", off - 80);
+            emit("  movsd [rbp-%d], xmm2\n", off - 88);
+            emit("  movsd [rbp-%d], xmm3\n", off - 96);
+            emit("  movsd [rbp-%d], xmm4\n", off - 104);
+            emit("  movsd [rbp-%d], xmm5\n", off - 112);
+            emit("  movsd [rbp-%d], xmm6\n", off - 120);
+            emit("  movsd [rbp-%d], xmm7\n", off - 128);
         }
 
+        // 最後の文だけは値を使う場所として生成し、その値がスタックに一つ残っている
         gen(current_fn->body);
-        // 式の評価結果としてスタックに一つの値が残っている
-        pop();
+        pop_result();
+        if (depth != 0) {
+            error("codegen() failure: %sのスタックの深さが合いません [%d]", current_fn->name, depth);
+        }
 
         // エピローグ
         // 最後の式の結果がRAXに残っているのでそれが返り値になる
-        printf(".L.return.%s:\n", current_fn->name);
-        printf("  mov rsp, rbp\n");
-        printf("  pop rbp\n");
-        printf("  ret\n");
+        emit(".L.return.%s:\n", current_fn->name);
+        gen_epilogue();
+        emit("  ret\n");
+    }
+
+    // 初期化式の定数部分
+    if (templates->len > 0) {
+        emit(".section .rodata\n");
+    }
+    for (int i = 0; i < templates->len; i++) {
+        Node *node = templates->body[i];
+        emit(".LT%d:\n", i);
+        for (int j = 0; j < node->val; j += 16) {
+            char *line = "  .byte ";
+            for (int k = j; k < node->val && k < j + 16; k++) {
+                line = format("%s%s%d", line, k == j ? "" : ",", (unsigned char)node->str_literal[k]);
+            }
+            emit("%s\n", line);
+        }
+    }
+
+    if (opt_level >= 1) {
+        code = peephole(code);
+        if (peephole_stats) {
+            print_peephole_stats();
+        }
+    }
+
+    for (int i = 0; i < code->len; i++) {
+        printf("%s\n", (char *)code->body[i]);
     }
 }
\ No newline at end of file
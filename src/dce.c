@@ -0,0 +1,231 @@
+#include "kcc.h"
+
+/*
+ * 不要コードの削除 (-O1以上)
+ *
+ * 到達しない文
+ *   return, break, continueの後ろにある同じブロックの文を取り除く。
+ *   switchのcaseを含む文は途中から実行されることがあるので残す。
+ *
+ * 定数条件の分岐
+ *   条件が定数になるif, 3項演算子は選ばれる側だけを残す。
+ *   条件が0のwhile, forは取り除く (forの初期化式は残す)。
+ *
+ * 不要な代入
+ *   一度も読まれず、アドレスも取られないローカル変数への代入を右辺の評価だけにする。
+ *
+ * 値を使わない式
+ *   文として書かれた副作用のない式 (int x; の宣言など) を取り除く。
+ *
+ * 取り除いた分で別の変数が読まれなくなることがあるので、変化がなくなるまで繰り返す。
+ * --dce-stats を指定すると関数ごとに取り除いたノードの数を表示する。
+ */
+
+static Vector *read_vars;  // 関数内で読まれるローカル変数
+
+static int removed_unreachable;
+static int removed_branch;
+static int removed_store;
+static int removed_unused;
+
+static Node *new_null_node() {
+    Node *node = memory_alloc(sizeof(Node));
+    node->kind = ND_NULL;
+    return node;
+}
+
+static int count_nodes(Node *node) {
+    if (node == NULL) return 0;
+    int n = 1;
+    n += count_nodes(node->lhs) + count_nodes(node->rhs);
+    n += count_nodes(node->cond) + count_nodes(node->then) + count_nodes(node->els);
+    n += count_nodes(node->body) + count_nodes(node->init) + count_nodes(node->inc);
+    for (int i = 0; node->args && i < node->args->len; i++) n += count_nodes(node->args->body[i]);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) n += count_nodes(node->stmts->body[i]);
+    return n;
+}
+
+// 代入の左辺以外に現れるローカル変数を集める
+static void collect_reads(Node *node) {
+    if (node == NULL) return;
+    if (node->kind == ND_VAR && !node->var->is_global) {
+        vec_union1(read_vars, node->var);
+    }
+
+    if (!(is_assignnode(node->kind) && node->lhs->kind == ND_VAR)) {
+        collect_reads(node->lhs);
+    }
+    collect_reads(node->rhs);
+    collect_reads(node->cond);
+    collect_reads(node->then);
+    collect_reads(node->els);
+    collect_reads(node->body);
+    collect_reads(node->init);
+    collect_reads(node->inc);
+    for (int i = 0; node->args && i < node->args->len; i++) collect_reads(node->args->body[i]);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) collect_reads(node->stmts->body[i]);
+}
+
+static bool is_dead_store(Node *node) {
+    if (node->kind != ND_ASSIGN || node->lhs->kind != ND_VAR) return false;
+    Var *var = node->lhs->var;
+    if (var->is_global || vec_contains(read_vars, var)) return false;
+
+    TypeKind kind = var->type->kind;
+    return is_integertype(kind) || kind == TYPE_PTR;
+}
+
+// 後続の文に到達しない文か
+static bool is_jump(Node *node) {
+    if (node == NULL) return false;
+    if (node->kind == ND_RETURN || node->kind == ND_BREAK || node->kind == ND_CONTINUE) {
+        return true;
+    }
+    if (node->kind == ND_BLOCK || node->kind == ND_SUGER || node->kind == ND_STMT_EXPR) {
+        return node->stmts->len > 0 && is_jump(vec_last(node->stmts));
+    }
+    if (node->kind == ND_IF) {
+        return node->els && is_jump(node->then) && is_jump(node->els);
+    }
+    return false;
+}
+
+// switchのcaseを含むか (入れ子のswitchのcaseは含めない)
+static bool has_case(Node *node) {
+    if (node == NULL || node->kind == ND_SWITCH) return false;
+    if (node->kind == ND_CASE || node->kind == ND_DEFAULT) return true;
+    if (has_case(node->lhs) || has_case(node->rhs) || has_case(node->then) || has_case(node->els) ||
+        has_case(node->body)) {
+        return true;
+    }
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) {
+        if (has_case(node->stmts->body[i])) return true;
+    }
+    return false;
+}
+
+static Node *dce(Node *node, bool used);
+
+static void dce_children(Node *node) {
+    node->lhs = dce(node->lhs, true);
+    node->rhs = dce(node->rhs, true);
+    node->cond = dce(node->cond, true);
+    node->then = dce(node->then, true);
+    node->els = dce(node->els, true);
+    for (int i = 0; node->args && i < node->args->len; i++) {
+        node->args->body[i] = dce(node->args->body[i], true);
+    }
+}
+
+static Node *dce_stmts(Node *node, bool used) {
+    Vector *stmts = new_vec();
+    for (int i = 0; i < node->stmts->len; i++) {
+        Node *stmt = node->stmts->body[i];
+        if (stmts->len > 0 && is_jump(vec_last(stmts)) && !has_case(stmt)) {
+            removed_unreachable += count_nodes(stmt);
+            continue;
+        }
+
+        // ブロックの値は最後の文の値になる
+        stmt = dce(stmt, used && i == node->stmts->len - 1);
+        if (stmt) {
+            vec_push(stmts, stmt);
+        }
+    }
+    node->stmts = stmts;
+    return node;
+}
+
+// usedがfalseなら値は使われないので、不要なら取り除いてNULLを返す
+static Node *dce(Node *node, bool used) {
+    if (node == NULL) return NULL;
+
+    long val;
+    switch (node->kind) {
+        case ND_IF:
+        case ND_TERNARY:
+            if (eval_const(node->cond, &val) && !has_case(val ? node->els : node->then)) {
+                Node *taken = val ? node->then : node->els;
+                removed_branch += count_nodes(node) - count_nodes(taken);
+                if (taken == NULL) {
+                    return used ? new_null_node() : NULL;
+                }
+                return dce(taken, used);
+            }
+            node->cond = dce(node->cond, true);
+            node->then = dce(node->then, used || node->kind == ND_TERNARY);
+            node->els = dce(node->els, used || node->kind == ND_TERNARY);
+            if (node->then == NULL) node->then = new_null_node();
+            return node;
+        case ND_WHILE:
+        case ND_FOR:
+            if (node->cond && eval_const(node->cond, &val) && val == 0 && !has_case(node->body)) {
+                removed_branch += count_nodes(node) - count_nodes(node->init);
+                Node *init = dce(node->init, false);
+                if (init == NULL && used) return new_null_node();
+                return init;
+            }
+            node->init = dce(node->init, false);
+            node->cond = dce(node->cond, true);
+            node->body = dce(node->body, false);
+            node->inc = dce(node->inc, false);
+            if (node->body == NULL) node->body = new_null_node();
+            return node;
+        case ND_BLOCK:
+        case ND_SUGER:
+        case ND_STMT_EXPR:
+            return dce_stmts(node, used);
+        case ND_INLINE:
+            dce_stmts(node, false);
+            node->body = dce(node->body, false);
+            if (node->body == NULL) node->body = new_null_node();
+            node->lhs = dce(node->lhs, true);
+            return node;
+        case ND_SWITCH:
+            node->cond = dce(node->cond, true);
+            node->body = dce(node->body, false);
+            if (node->body == NULL) node->body = new_null_node();
+            return node;
+        case ND_CASE:
+        case ND_DEFAULT:
+            node->lhs = dce(node->lhs, used);
+            if (node->lhs == NULL) node->lhs = new_null_node();
+            return node;
+        case ND_ASSIGN:
+            if (!used && is_dead_store(node)) {
+                removed_store += 2;  // 代入と左辺
+                return dce(node->rhs, false);
+            }
+            dce_children(node);
+            return node;
+        default:
+            if (!used && is_pure(node)) {
+                removed_unused += count_nodes(node);
+                return NULL;
+            }
+            dce_children(node);
+            return node;
+    }
+}
+
+void eliminate_dead_code() {
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        if (fn->is_prototype) continue;
+
+        removed_unreachable = removed_branch = removed_store = removed_unused = 0;
+        int removed = -1;
+        while (removed != removed_unreachable + removed_branch + removed_store + removed_unused) {
+            removed = removed_unreachable + removed_branch + removed_store + removed_unused;
+            read_vars = new_vec();
+            collect_reads(fn->body);
+            // 末尾まで実行したときはraxに残った値が返り値になるので、最後の文の値は残す
+            fn->body = dce(fn->body, fn->ret_type->kind != TYPE_VOID);
+        }
+
+        if (dce_stats && removed > 0) {
+            fprintf(stderr, "dce: %s: removed %d nodes (unreachable %d, constant branch %d, dead store %d, unused value %d)\n",
+                    fn->name, removed, removed_unreachable, removed_branch, removed_store, removed_unused);
+        }
+    }
+}
@@ -66,6 +66,22 @@ void print_node_kind(NodeKind kind) {
         fprintf(stderr, "ND_CONTINUE");  // continue
     else if (kind == ND_BREAK)
         fprintf(stderr, "ND_BREAK");  // break
+    else if (kind == ND_SWITCH)
+        fprintf(stderr, "ND_SWITCH");  // switch
+    else if (kind == ND_CASE)
+        fprintf(stderr, "ND_CASE");  // case
+    else if (kind == ND_DEFAULT)
+        fprintf(stderr, "ND_DEFAULT");  // default
+    else if (kind == ND_VECTOR_LOOP)
+        fprintf(stderr, "ND_VECTOR_LOOP");  // ベクトル化したループ
+    else if (kind == ND_ZERO_FILL)
+        fprintf(stderr, "ND_ZERO_FILL");  // 0で埋める
+    else if (kind == ND_TEMPLATE_COPY)
+        fprintf(stderr, "ND_TEMPLATE_COPY");  // 初期化式の定数部分のコピー
+    else if (kind == ND_ASSIGN_OP)
+        fprintf(stderr, "ND_ASSIGN_OP");  // += など
+    else if (kind == ND_POST_INCDEC)
+        fprintf(stderr, "ND_POST_INCDEC");  // 後置の++ --
     else if (kind == ND_LOGICALNOT)
         fprintf(stderr, "ND_LOGICALNOT");  // !
     else if (kind == ND_LOGICAL_AND)
@@ -88,6 +104,8 @@ void print_node_kind(NodeKind kind) {
         fprintf(stderr, "ND_CAST");  // cast
     else if (kind == ND_STMT_EXPR)
         fprintf(stderr, "ND_STMT_EXPR");  // stmt in expr
+    else if (kind == ND_INLINE)
+        fprintf(stderr, "ND_INLINE");  // inline
     else
         error("print_node_kind() failure");
 
@@ -156,6 +174,12 @@ void print_token_kind(TokenKind kind) {
         fprintf(stderr, "TK_CONTINUE");
     else if (kind == TK_BREAK)
         fprintf(stderr, "TK_BREAK");
+    else if (kind == TK_SWITCH)
+        fprintf(stderr, "TK_SWITCH");
+    else if (kind == TK_CASE)
+        fprintf(stderr, "TK_CASE");
+    else if (kind == TK_DEFAULT)
+        fprintf(stderr, "TK_DEFAULT");
     else if (kind == TK_LOGICAL_AND)
         fprintf(stderr, "TK_LOGICAL_AND");
     else if (kind == TK_LOGICAL_OR)
@@ -172,6 +196,8 @@ void print_token_kind(TokenKind kind) {
         fprintf(stderr, "TK_VARIADIC");
     else if (kind == TK_EXTERN)
         fprintf(stderr, "TK_EXTERN");
+    else if (kind == TK_STATIC)
+        fprintf(stderr, "TK_STATIC");
     else
         fprintf(stderr, "TK_[%c]", kind);
 
@@ -0,0 +1,420 @@
+#include "kcc.h"
+
+/*
+ * 関数のインライン展開 (-O1以上)
+ *
+ * 呼び出し f(a, b) を次のND_INLINEに置き換える。
+ *   stmts: 引数を一時変数に代入する式 (p1 = a, p2 = b)
+ *   body:  fの本体の複製 (ローカル変数は呼び出し元の一時変数に置き換える)
+ *   lhs:   返り値を入れた一時変数 (voidならNULL)
+ *   val:   展開ごとの番号
+ * 本体の中のreturnは返り値の変数に代入してから展開の末尾に飛ぶ (ND_RETURNのvalに番号を持つ)。
+ *
+ * 展開するのは本体のノード数がINLINE_THRESHOLD以下の関数と、
+ * 一度しか呼ばれないstatic関数。可変長引数の関数と、呼び出しグラフをたどって
+ * 展開中の関数に戻ってくる関数 (相互再帰を含む再帰) は展開しない。
+ * return f(...) の呼び出しは末尾呼び出し (jmp) にするので展開しない。
+ * 全ての呼び出しを展開したstatic関数は出力しない。
+ */
+
+// これ以下のノード数の関数を展開する
+#define INLINE_THRESHOLD 40
+// 展開した本体の中をさらに展開する深さの上限
+#define INLINE_MAX_DEPTH 4
+
+static Function *caller;
+static Vector *orig_bodies;  // 展開前の各関数の本体 (funcsと同じ順)
+static Vector *call_counts;  // 各関数が呼ばれる箇所の数 (funcsと同じ順)
+static Vector *callees;      // 各関数が呼ぶ関数の番号 (funcsと同じ順、intのVector)
+static Vector *stack;        // 展開中の関数
+static Node *tail_call;      // 展開しない末尾位置の呼び出し
+static int inline_count;
+
+// 複製中の変数の対応表 (NULLなら変数を置き換えない)
+static Vector *var_from;
+static Vector *var_to;
+static Var *ret_var;
+static int ret_id;
+
+static int func_index(char *name) {
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        if (!fn->is_prototype && strcmp(fn->name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// プロトタイプ宣言にstaticがついている場合も含める
+static bool is_static_func(char *name) {
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        if (fn->is_static && strcmp(fn->name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int count_nodes(Node *node) {
+    if (node == NULL) return 0;
+    int n = 1;
+    n += count_nodes(node->lhs) + count_nodes(node->rhs);
+    n += count_nodes(node->cond) + count_nodes(node->then) + count_nodes(node->els);
+    n += count_nodes(node->body) + count_nodes(node->init) + count_nodes(node->inc);
+    for (int i = 0; node->args && i < node->args->len; i++) n += count_nodes(node->args->body[i]);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) n += count_nodes(node->stmts->body[i]);
+    return n;
+}
+
+static void count_calls(Node *node, int *counts) {
+    if (node == NULL) return;
+    if (node->kind == ND_CALL) {
+        int i = func_index(node->fn_name);
+        if (i >= 0) counts[i]++;
+    }
+    count_calls(node->lhs, counts);
+    count_calls(node->rhs, counts);
+    count_calls(node->cond, counts);
+    count_calls(node->then, counts);
+    count_calls(node->els, counts);
+    count_calls(node->body, counts);
+    count_calls(node->init, counts);
+    count_calls(node->inc, counts);
+    for (int i = 0; node->args && i < node->args->len; i++) count_calls(node->args->body[i], counts);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) count_calls(node->stmts->body[i], counts);
+}
+
+static void collect_callees(Node *node, Vector *v) {
+    if (node == NULL) return;
+    if (node->kind == ND_CALL) {
+        int i = func_index(node->fn_name);
+        if (i >= 0 && !vec_contains(v, (void *)(long)i)) vec_push(v, (void *)(long)i);
+    }
+    collect_callees(node->lhs, v);
+    collect_callees(node->rhs, v);
+    collect_callees(node->cond, v);
+    collect_callees(node->then, v);
+    collect_callees(node->els, v);
+    collect_callees(node->body, v);
+    collect_callees(node->init, v);
+    collect_callees(node->inc, v);
+    for (int i = 0; node->args && i < node->args->len; i++) collect_callees(node->args->body[i], v);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) collect_callees(node->stmts->body[i], v);
+}
+
+// 関数fromから呼び出しをたどって関数toに到達できるか
+static bool reaches(int from, Function *to, bool *visited) {
+    if (funcs->body[from] == to) return true;
+    if (visited[from]) return false;
+    visited[from] = true;
+
+    Vector *v = callees->body[from];
+    for (int i = 0; i < v->len; i++) {
+        if (reaches((long)v->body[i], to, visited)) return true;
+    }
+    return false;
+}
+
+/*
+ * 本体の複製
+ */
+
+static Var *map_var(Var *var) {
+    for (int i = 0; i < var_from->len; i++) {
+        if (var_from->body[i] == var) {
+            return var_to->body[i];
+        }
+    }
+    Var *to = new_temp_lvar(caller, var->type);
+    vec_push(var_from, var);
+    vec_push(var_to, to);
+    return to;
+}
+
+static Vector *clone_vec(Vector *v);
+
+static Node *clone(Node *node) {
+    if (node == NULL) return NULL;
+
+    Node *n = memory_alloc(sizeof(Node));
+    *n = *node;
+    if (n->kind == ND_VAR && !n->var->is_global && var_from) {
+        n->var = map_var(n->var);
+    }
+
+    n->lhs = clone(node->lhs);
+    n->rhs = clone(node->rhs);
+    n->cond = clone(node->cond);
+    n->then = clone(node->then);
+    n->els = clone(node->els);
+    n->body = clone(node->body);
+    n->init = clone(node->init);
+    n->inc = clone(node->inc);
+    n->args = clone_vec(node->args);
+    n->stmts = clone_vec(node->stmts);
+    if (node->scope_vars && var_from) {
+        n->scope_vars = new_vec();
+        for (int i = 0; i < node->scope_vars->len; i++) {
+            vec_push(n->scope_vars, map_var(node->scope_vars->body[i]));
+        }
+    }
+
+    if (n->kind == ND_RETURN && ret_id) {
+        // 返り値の変数に代入して展開の末尾に飛ぶ
+        n->val = ret_id;
+        if (n->lhs && ret_var) {
+            Node *lhs = memory_alloc(sizeof(Node));
+            lhs->kind = ND_VAR;
+            lhs->var = ret_var;
+            lhs->type = ret_var->type;
+
+            Node *assign = memory_alloc(sizeof(Node));
+            assign->kind = ND_ASSIGN;
+            assign->lhs = lhs;
+            assign->rhs = n->lhs;
+            assign->type = ret_var->type;
+            n->lhs = assign;
+        }
+    }
+    return n;
+}
+
+static Vector *clone_vec(Vector *v) {
+    if (v == NULL) return NULL;
+    Vector *to = new_vec();
+    for (int i = 0; i < v->len; i++) {
+        vec_push(to, clone(v->body[i]));
+    }
+    return to;
+}
+
+/*
+ * 展開するかどうかの判断
+ */
+
+static void report(Node *call, char *fmt, ...) {
+    if (!inline_report) return;
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "inline: %s -> %s: %s\n", caller->name, call->fn_name, vformat(fmt, ap));
+    va_end(ap);
+}
+
+static bool ends_with_return(Node *body) {
+    Vector *stmts = body->stmts;
+    return stmts && stmts->len > 0 && ((Node *)vec_last(stmts))->kind == ND_RETURN;
+}
+
+// fnの本体から展開中の関数に戻ってくるなら再帰になる
+static bool is_recursive(int index) {
+    for (int i = -1; i < stack->len; i++) {
+        Function *fn = i < 0 ? caller : stack->body[i];
+        if (reaches(index, fn, memory_alloc(sizeof(bool) * funcs->len))) return true;
+    }
+    return false;
+}
+
+// 展開できない理由を返す (展開できるならNULL)
+static char *check_inlinable(Node *call, int index) {
+    if (index < 0) return "not inlined (no definition)";
+
+    Function *fn = funcs->body[index];
+    if (fn->is_variadic) return "not inlined (variadic)";
+    if (is_recursive(index)) return "not inlined (recursive)";
+    if (call == tail_call) return "not inlined (tail call)";
+    if (stack->len >= INLINE_MAX_DEPTH) return "not inlined (too deep)";
+    if (fn->ret_type->kind == TYPE_STRUCT) return "not inlined (returns struct)";
+    if (fn->ret_type->kind != TYPE_VOID && !ends_with_return(fn->body)) {
+        // 末尾に到達したときの返り値 (raxに残った値) を再現できない
+        return "not inlined (no return at end)";
+    }
+
+    int nparams = 0;
+    for (Var *param = fn->params; param; param = param->next) {
+        TypeKind kind = param->type->kind;
+        if (!param->lvar || !(is_integertype(kind) || kind == TYPE_PTR)) {
+            return "not inlined (non-scalar parameter)";
+        }
+        nparams++;
+    }
+    if (nparams != call->args->len) return "not inlined (argument count mismatch)";
+    return NULL;
+}
+
+static void inline_node(Node **np);
+
+static Node *expand(Node *call, Function *fn, Node *body) {
+    var_from = new_vec();
+    var_to = new_vec();
+    ret_var = fn->ret_type->kind == TYPE_VOID ? NULL : new_temp_lvar(caller, fn->ret_type);
+    ret_id = ++inline_count;
+
+    Node *node = memory_alloc(sizeof(Node));
+    node->kind = ND_INLINE;
+    node->val = ret_id;
+    node->type = fn->ret_type;
+    node->fn_name = fn->name;
+
+    // 引数を仮引数の一時変数に代入する
+    node->stmts = new_vec();
+    int i = 0;
+    for (Var *param = fn->params; param; param = param->next, i++) {
+        Var *to = map_var(param->lvar);
+
+        Node *lhs = memory_alloc(sizeof(Node));
+        lhs->kind = ND_VAR;
+        lhs->var = to;
+        lhs->type = to->type;
+
+        Node *assign = memory_alloc(sizeof(Node));
+        assign->kind = ND_ASSIGN;
+        assign->lhs = lhs;
+        assign->rhs = call->args->body[i];
+        assign->type = to->type;
+        vec_push(node->stmts, assign);
+    }
+
+    node->body = clone(body);
+
+    if (ret_var) {
+        Node *ret = memory_alloc(sizeof(Node));
+        ret->kind = ND_VAR;
+        ret->var = ret_var;
+        ret->type = ret_var->type;
+        node->lhs = ret;
+    }
+
+    // 展開した本体の中の呼び出しも展開する
+    vec_push(stack, fn);
+    inline_node(&node->body);
+    vec_pop(stack);
+    return node;
+}
+
+static void try_inline(Node **np) {
+    Node *call = *np;
+    if (strcmp(call->fn_name, "va_start") == 0) return;
+
+    int index = func_index(call->fn_name);
+    char *reason = check_inlinable(call, index);
+    if (reason) {
+        report(call, "%s", reason);
+        return;
+    }
+
+    Function *fn = funcs->body[index];
+    Node *body = orig_bodies->body[index];
+    int cost = count_nodes(body);
+    int calls = (long)call_counts->body[index];
+    // 展開した本体の中の呼び出しは元の呼び出しとは別の箇所になるので含めない
+    bool is_static_once = is_static_func(fn->name) && calls == 1 && stack->len == 0;
+
+    if (cost > INLINE_THRESHOLD && !is_static_once) {
+        report(call, "not inlined (cost %d > %d)", cost, INLINE_THRESHOLD);
+        return;
+    }
+
+    report(call, "inlined (cost %d%s)", cost, is_static_once ? ", static function called once" : "");
+    *np = expand(call, fn, body);
+}
+
+// 展開していない本体のreturn f(...) は末尾呼び出しにできる
+static Node *find_tail_call(Node *node) {
+    if (!optimize_sibling_calls || node->kind != ND_RETURN || node->val || node->lhs == NULL) return NULL;
+
+    Node *call = node->lhs;
+    while (call->kind == ND_SUGER && call->stmts->len == 1) {
+        call = call->stmts->body[0];
+    }
+    if (call->kind != ND_CALL) return NULL;
+
+    int index = func_index(call->fn_name);
+    if (index < 0) return NULL;
+    Type *ret = ((Function *)funcs->body[index])->ret_type;
+    if (ret->kind != caller->ret_type->kind || ret->size != caller->ret_type->size) return NULL;
+    return call;
+}
+
+static void inline_node(Node **np) {
+    Node *node = *np;
+    if (node == NULL) return;
+
+    Node *tail = find_tail_call(node);
+    if (tail) tail_call = tail;
+
+    // 引数の中の呼び出しを先に展開する
+    inline_node(&node->lhs);
+    inline_node(&node->rhs);
+    inline_node(&node->cond);
+    inline_node(&node->then);
+    inline_node(&node->els);
+    inline_node(&node->body);
+    inline_node(&node->init);
+    inline_node(&node->inc);
+    for (int i = 0; node->args && i < node->args->len; i++) inline_node((Node **)&node->args->body[i]);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) inline_node((Node **)&node->stmts->body[i]);
+
+    if (node->kind == ND_CALL) {
+        try_inline(np);
+    }
+}
+
+// 呼び出しが残っていないstatic関数を取り除く
+static void delete_unused_static_funcs() {
+    int *counts = memory_alloc(sizeof(int) * funcs->len);
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        if (!fn->is_prototype) count_calls(fn->body, counts);
+    }
+
+    Vector *live = new_vec();
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        if (!fn->is_prototype && counts[i] == 0 && is_static_func(fn->name) && strcmp(fn->name, "main") != 0) {
+            if (inline_report) {
+                fprintf(stderr, "inline: %s: removed (all calls inlined)\n", fn->name);
+            }
+            continue;
+        }
+        vec_push(live, fn);
+    }
+    funcs->len = 0;
+    vec_concat(funcs, live);
+}
+
+void inline_functions() {
+    orig_bodies = new_vec();
+    call_counts = new_vec();
+    callees = new_vec();
+    stack = new_vec();
+
+    int *counts = memory_alloc(sizeof(int) * funcs->len);
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        if (!fn->is_prototype) count_calls(fn->body, counts);
+    }
+
+    // 展開で書き換わる前の本体を複製しておく
+    for (int i = 0; i < funcs->len; i++) {
+        Function *fn = funcs->body[i];
+        var_from = NULL;
+        ret_var = NULL;
+        ret_id = 0;
+        vec_push(orig_bodies, fn->is_prototype ? NULL : clone(fn->body));
+        vec_push(call_counts, (void *)(long)counts[i]);
+
+        Vector *v = new_vec();
+        if (!fn->is_prototype) collect_callees(fn->body, v);
+        vec_push(callees, v);
+    }
+
+    for (int i = 0; i < funcs->len; i++) {
+        caller = funcs->body[i];
+        if (caller->is_prototype) continue;
+        inline_node(&caller->body);
+    }
+
+    delete_unused_static_funcs();
+}
@@ -1,5 +1,6 @@
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -105,6 +106,10 @@ enum TokenKind {
     TK_VARIADIC,     // ...
     TK_INCLUDE,      // include
     TK_EXTERN,       // extern
+    TK_STATIC,       // static
+    TK_SWITCH,       // switch
+    TK_CASE,         // case
+    TK_DEFAULT,      // default
 };
 
 struct Token {
@@ -128,11 +133,16 @@ struct Var {
     int next_offset;  // ローカルスコープでのオフセットを管理
     Type *type;       // 型情報
     long val;         // 定数の場合は値を持つ
+    int reg;          // 割り当てられたレジスタ (0ならメモリ上)
+    Var *lvar;        // 引数の場合、関数本体で使うローカル変数
 
     bool is_global;
     bool is_only_type;
     bool is_extern;
-    Vector *ginit;  // GInit_elのVector
+    bool is_static;   // staticつきのグローバル変数 (.globlをつけない)
+    bool is_typedef;  // typedefで宣言された型名 (実体を持たない)
+    char *init_data;  // グローバル変数の初期値のバイト列 (初期化式がなければNULL)
+    Vector *relocs;   // アドレスの初期値 (GInit_elのstrにラベル、valに変数内の位置)
 };
 
 /* ノードの定義 */
@@ -176,23 +186,35 @@ enum NodeKind {
     ND_TERNARY,        // 3項演算子
     ND_CAST,           // キャスト
     ND_STMT_EXPR,      // stmt in expr
+    ND_INLINE,         // インライン展開した関数呼び出し
+    ND_SWITCH,         // switch
+    ND_CASE,           // case
+    ND_DEFAULT,        // default
+    ND_VECTOR_LOOP,    // ベクトル化したループ
+    ND_ZERO_FILL,      // 変数のvalバイト目から末尾までを0で埋める
+    ND_TEMPLATE_COPY,  // 初期化式の定数部分をコピーする
+    ND_ASSIGN_OP,      // 複合代入 (+= など) と前置の++ --。rhsは lhs op x で、値は代入後のlhs
+    ND_POST_INCDEC,    // 後置の++ --。rhsは lhs ± 1 で、値は代入前のlhs
 };
 
 struct Node {
     NodeKind kind;
     Node *lhs;          // 左辺
     Node *rhs;          // 右辺
-    long val;           // ND_NUM ND_STRINGの時に使う
+    long val;           // ND_NUM ND_STRING ND_CASE ND_ZERO_FILL ND_TEMPLATE_COPYの時に使う
     Var *var;           // kindがND_VARの場合のみ使う
     char *fn_name;      //
-    char *str_literal;  // ND_STRINGのときに使う
+    char *str_literal;  // ND_STRING ND_TEMPLATE_COPY (valバイトの定数) のときに使う
     Vector *args;       //
     Vector *stmts;      //
+    Vector *scope_vars;  // ND_BLOCK ND_FORのスコープで宣言したローカル変数
     Type *type;         // 型
 
     // if (cond) then els
     // while (cond) body
     // for (init;cond;inc) body
+    // switch (cond) body
+    // case val: lhs
     Node *cond;
     Node *then;
     Node *els;
@@ -209,11 +231,15 @@ struct Function {
     Var *locals;
     Var *va_area;
     int stack_size;
+    Vector *saved_regs;   // 退避が必要なcallee-savedレジスタ
+    Vector *cache_regs;   // 変数に割り当てず、スタックの先頭のキャッシュに使えるレジスタ
 
     Type *ret_type;  // return_type
 
     bool is_prototype;
     bool is_variadic;
+    bool is_static;
+    bool omit_frame_pointer;  // rbpを使わず、rspからの相対でスタック上の変数を参照する
 };
 
 struct Initializer {
@@ -252,9 +278,15 @@ bool startsWith(char *p, char *q);
 void error_at(char *loc, char *msg);
 void error(char *fmt, ...);
 char *my_strndup(char *s, size_t n);
+char *vformat(char *fmt, va_list ap);
+char *format(char *fmt, ...);
 void swap(void **p, void **q);
 void *memory_alloc(size_t size);
 void copy_func(Function *to, Function *from);
+Vector *switch_cases(Node *node, Node **default_case);
+bool eval_const(Node *node, long *val);
+bool is_pure(Node *node);
+Node *assign_op_operand(Node *node);
 
 // debug.c
 void print_node_kind(NodeKind kind);
@@ -280,6 +312,27 @@ void *vec_delete(Vector *v, int index);
 // codegen.c
 void codegen();
 
+// dce.c
+void eliminate_dead_code();
+
+// inline.c
+void inline_functions();
+
+// optimize.c
+void optimize();
+Var *new_temp_lvar(Function *fn, Type *ty);
+
+// peephole.c
+Vector *peephole(Vector *code);
+void print_peephole_stats();
+
+// regalloc.c
+void alloc_regs(Function *fn);
+char *reg_name(int reg);
+
+// vectorize.c
+void vectorize_loops();
+
 // token.c
 Token *tokenize(char *p);
 
@@ -289,7 +342,9 @@ Type *new_ptr_type(Type *ptr_to);
 Type *new_array_type(Type *ptr_to, int size);
 void add_type(Node *node);
 int sizeOfType(Type *ty);
+int alignOfType(Type *ty);
 bool is_integertype(TypeKind kind);
+bool is_assignnode(NodeKind kind);
 TypeKind large_numtype(Type *t1, Type *t2);
 bool can_type_cast(Type *ty, TypeKind to);
 int array_base_type_size(Type *ty);
@@ -307,6 +362,13 @@ Var *globals;
 Token *token;      // tokenは単方向の連結リスト
 char *user_input;  // 入力プログラム
 char *file_name;
+int opt_level;         // 最適化レベル (-O0でスタックマシンのみ)
+bool peephole_stats;   // --peephole-stats: のぞき穴最適化の規則ごとの適用回数を表示
+bool omit_frame_pointer;      // -fomit-frame-pointer: rbpを使わずにスタックフレームを組む
+bool optimize_sibling_calls;  // -fno-optimize-sibling-calls: 末尾呼び出しをjmpにしない
+bool inline_report;    // --inline-report: 呼び出しごとのインライン展開の判断を表示
+bool dce_stats;        // --dce-stats: 関数ごとに不要コードの削除で取り除いたノード数を表示
+bool vectorize_report;  // --vectorize-report: ループごとのベクトル化の判断を表示
 Vector *funcs;         // Function型のVector
 int label_if_count;    // ifのラベル
 int label_loop_count;  // forとwhileのラベル
@@ -3,6 +3,8 @@
 void init() {
     label_if_count = 0;    // ifのラベルにつけるユニークな値
     label_loop_count = 0;  // loopのラベルにつけるユニークな値
+    opt_level = 1;         // デフォルトでレジスタ割り当てを行う
+    optimize_sibling_calls = true;
     globals = NULL;        // グローバル変数の初期化
     struct_global_lists = new_vec();
     struct_local_lists = new_vec();
@@ -39,19 +41,86 @@ char *read_file(char *path) {
     return buf;
 }
 
-int main(int argc, char **argv) {
-    if (argc != 2) {
-        fprintf(stderr, "引数の個数が正しくありません。\n");
-        return EXIT_FAILURE;
+// コマンドライン引数を解析する
+// kcc [-O[<n>]] [-fomit-frame-pointer] [-fno-optimize-sibling-calls] [--peephole-stats] [--inline-report] [--dce-stats] [--vectorize-report] <file>
+static void parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-O", 2) == 0) {
+            char *level = argv[i] + 2;
+            if (*level == '\0') {
+                // -Oだけなら-O1
+                opt_level = 1;
+                continue;
+            }
+            char *end;
+            opt_level = strtol(level, &end, 10);
+            if (!isdigit(*level) || *end != '\0') {
+                error("不正な最適化レベルです: %s", argv[i]);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-fomit-frame-pointer") == 0) {
+            omit_frame_pointer = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-fno-optimize-sibling-calls") == 0) {
+            optimize_sibling_calls = false;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--peephole-stats") == 0) {
+            peephole_stats = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--inline-report") == 0) {
+            inline_report = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--dce-stats") == 0) {
+            dce_stats = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--vectorize-report") == 0) {
+            vectorize_report = true;
+            continue;
+        }
+
+        if (argv[i][0] == '-') {
+            error("不明なオプションです: %s", argv[i]);
+        }
+
+        if (file_name) {
+            error("入力ファイルは一つだけ指定できます");
+        }
+        file_name = argv[i];
+    }
+
+    if (file_name == NULL) {
+        error("引数の個数が正しくありません。");
     }
+}
 
+int main(int argc, char **argv) {
     init();
-    file_name = argv[1];
+    parse_args(argc, argv);
     user_input = read_file(file_name);
 
     token = tokenize(user_input);
     token = preprocess(token);
     program();
+
+    if (opt_level >= 1) {
+        inline_functions();
+        eliminate_dead_code();
+        optimize();
+        vectorize_loops();
+    }
+
     codegen();
 
     return EXIT_SUCCESS;
@@ -0,0 +1,444 @@
+#include "kcc.h"
+
+/*
+ * ASTに対する最適化 (-O1以上)
+ *
+ * ループ不変式の移動 (LICM)
+ *   ループの中で値が変わらない純粋な式を一時変数に入れ、ループの前で一度だけ計算する。
+ *   a[i][j] の a[i] の部分 (行の先頭アドレス) などが対象になる。
+ *
+ * スカラー置換
+ *   アドレスを取られないグローバル変数をループの間だけローカルな一時変数に置き換える。
+ *   一時変数はレジスタに割り当てられるので、ループ中の読み書きがメモリを経由しなくなる。
+ *   書き込みがあればループの後でグローバル変数に書き戻す。
+ *
+ * どちらも変換後のループは ND_SUGER { 前処理; ループ; 後処理 } になる。
+ */
+
+typedef struct Loop Loop;
+
+// 最適化中のループの情報
+struct Loop {
+    Vector *assigned;  // ループ内で代入される変数
+    bool has_call;     // 関数呼び出しを含む
+    bool has_return;   // returnを含む
+    Vector *pre;       // ループの前に置く文
+    Vector *hoisted;   // 移動した式 (pre[i]の右辺)
+    Vector *temps;     // 移動した式を入れた一時変数
+};
+
+static Function *fn;
+static Vector *escaped_locals;    // 関数内でアドレスを取られたローカル変数
+static Vector *escaped_globals;   // プログラム全体でアドレスを取られたグローバル変数
+static int ntemp;
+
+static Node *new_node(NodeKind kind, Type *ty) {
+    Node *node = memory_alloc(sizeof(Node));
+    node->kind = kind;
+    node->type = ty;
+    return node;
+}
+
+static Node *new_var_node(Var *var) {
+    Node *node = new_node(ND_VAR, var->type);
+    node->var = var;
+    return node;
+}
+
+static Node *new_assign(Var *var, Node *rhs) {
+    Node *node = new_node(ND_ASSIGN, var->type);
+    node->lhs = new_var_node(var);
+    node->rhs = rhs;
+    return node;
+}
+
+static Node *new_suger(Vector *stmts) {
+    Node *node = new_node(ND_SUGER, NULL);
+    node->stmts = stmts;
+    return node;
+}
+
+// スタックフレームの末尾に一時変数を確保する
+Var *new_temp_lvar(Function *f, Type *ty) {
+    Var *top = f->locals;
+    int size = top->next_offset > 0 ? top->next_offset : top->offset;
+
+    Var *var = memory_alloc(sizeof(Var));
+    var->name = format(".tmp%d", ntemp++);
+    var->len = strlen(var->name);
+    var->type = ty;
+    var->offset = size + sizeOfType(ty);
+    top->next_offset = var->offset;
+    return var;
+}
+
+static Type *type_of(Node *node) {
+    if (node->type == NULL) {
+        if (node->lhs) type_of(node->lhs);
+        if (node->rhs) type_of(node->rhs);
+        add_type(node);
+    }
+    return node->type;
+}
+
+static bool is_scalar(Type *ty) {
+    return is_integertype(ty->kind) || ty->kind == TYPE_PTR;
+}
+
+/*
+ * ASTの走査
+ */
+
+static void walk(Node *node, void (*f)(Node *, void *), void *arg) {
+    if (node == NULL) return;
+    f(node, arg);
+    walk(node->lhs, f, arg);
+    walk(node->rhs, f, arg);
+    walk(node->cond, f, arg);
+    walk(node->then, f, arg);
+    walk(node->els, f, arg);
+    walk(node->body, f, arg);
+    walk(node->init, f, arg);
+    walk(node->inc, f, arg);
+    if (node->args) {
+        for (int i = 0; i < node->args->len; i++) walk(node->args->body[i], f, arg);
+    }
+    if (node->stmts) {
+        for (int i = 0; i < node->stmts->len; i++) walk(node->stmts->body[i], f, arg);
+    }
+}
+
+static void find_escaped(Node *node) {
+    if (node == NULL) return;
+    if (node->kind == ND_ADDR && node->lhs->kind == ND_VAR) {
+        Var *var = node->lhs->var;
+        vec_union1(var->is_global ? escaped_globals : escaped_locals, var);
+    }
+    find_escaped(node->lhs);
+    find_escaped(node->rhs);
+    find_escaped(node->cond);
+    find_escaped(node->then);
+    find_escaped(node->els);
+    find_escaped(node->body);
+    find_escaped(node->init);
+    find_escaped(node->inc);
+    if (node->args) {
+        for (int i = 0; i < node->args->len; i++) find_escaped(node->args->body[i]);
+    }
+    if (node->stmts) {
+        for (int i = 0; i < node->stmts->len; i++) find_escaped(node->stmts->body[i]);
+    }
+}
+
+static void collect_loop_info(Node *node, void *arg) {
+    Loop *loop = arg;
+    if (is_assignnode(node->kind) && node->lhs->kind == ND_VAR) {
+        vec_union1(loop->assigned, node->lhs->var);
+    } else if (node->kind == ND_CALL) {
+        loop->has_call = true;
+    } else if (node->kind == ND_RETURN) {
+        loop->has_return = true;
+    }
+}
+
+// グローバル変数の初期化式 (int *p = &g; など) でアドレスを取られているか
+static bool is_referred_by_relocs(Var *var) {
+    int len = strlen(var->name);
+    for (Var *g = globals; g; g = g->next) {
+        for (int i = 0; g->relocs && i < g->relocs->len; i++) {
+            GInit_el *el = g->relocs->body[i];
+            if (el->str && strncmp(el->str, var->name, len) == 0 && !is_alnum(el->str[len])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void find_escaped_globals() {
+    escaped_globals = new_vec();
+    escaped_locals = new_vec();
+    for (int i = 0; i < funcs->len; i++) {
+        Function *f = funcs->body[i];
+        if (f->is_prototype) continue;
+        find_escaped(f->body);
+    }
+    for (Var *var = globals; var; var = var->next) {
+        if (is_referred_by_relocs(var)) {
+            vec_union1(escaped_globals, var);
+        }
+    }
+}
+
+/*
+ * スカラー置換
+ */
+
+typedef struct {
+    Var *from;
+    Var *to;
+    bool written;
+} Promotion;
+
+static void collect_globals(Node *node, void *arg) {
+    Vector *vars = arg;
+    if (node->kind == ND_VAR && node->var->is_global && is_scalar(node->var->type) &&
+        !vec_contains(escaped_globals, node->var)) {
+        vec_union1(vars, node->var);
+    }
+}
+
+static void replace_var(Node *node, void *arg) {
+    Promotion *p = arg;
+    if (node->kind == ND_VAR && node->var == p->from) {
+        node->var = p->to;
+    }
+    if (is_assignnode(node->kind) && node->lhs->kind == ND_VAR && node->lhs->var == p->from) {
+        p->written = true;
+    }
+}
+
+// ループ中のグローバル変数を一時変数に置き換え、前後の読み書きをpre, postに追加する
+static void promote_globals(Node *node, Loop *loop, Vector *post) {
+    // 呼び出し先やreturn後の処理から書き戻し前の値が見えてしまう
+    if (loop->has_call || loop->has_return) return;
+
+    Vector *vars = new_vec();
+    walk(node->cond, collect_globals, vars);
+    walk(node->body, collect_globals, vars);
+    walk(node->inc, collect_globals, vars);
+
+    for (int i = 0; i < vars->len; i++) {
+        Var *var = vars->body[i];
+        Promotion p = {var, new_temp_lvar(fn, var->type), false};
+        walk(node->cond, replace_var, &p);
+        walk(node->body, replace_var, &p);
+        walk(node->inc, replace_var, &p);
+
+        vec_push(loop->pre, new_assign(p.to, new_var_node(var)));
+        if (p.written) {
+            vec_push(post, new_assign(var, new_var_node(p.to)));
+        }
+    }
+}
+
+/*
+ * ループ不変式の移動
+ */
+
+static bool is_invariant_var(Var *var, Loop *loop) {
+    // 配列は先頭アドレスとして扱われるので変わらない
+    if (var->type->kind == TYPE_ARRAY) return true;
+    if (!is_scalar(var->type)) return false;
+    if (vec_contains(loop->assigned, var)) return false;
+
+    if (var->is_global) {
+        return !loop->has_call && !vec_contains(escaped_globals, var);
+    }
+    return !vec_contains(escaped_locals, var);
+}
+
+// 副作用や例外を起こさず、ループ中で値が変わらない式か
+// (除算は0除算の可能性があるので移動しない)
+static bool is_invariant(Node *node, Loop *loop) {
+    switch (node->kind) {
+        case ND_NUM:
+            return true;
+        case ND_VAR:
+            return is_invariant_var(node->var, loop);
+        case ND_ADDR:
+            return node->lhs->kind == ND_VAR;
+        case ND_DEREF:
+            // 配列型へのderefはメモリを読まずアドレスを返すだけ
+            return type_of(node)->kind == TYPE_ARRAY && is_invariant(node->lhs, loop);
+        case ND_ADD:
+        case ND_SUB:
+        case ND_MUL:
+        case ND_AND:
+        case ND_OR:
+        case ND_XOR:
+        case ND_LSHIFT:
+        case ND_RSHIFT:
+        case ND_EQ:
+        case ND_NE:
+        case ND_LT:
+        case ND_LE:
+            return is_invariant(node->lhs, loop) && is_invariant(node->rhs, loop);
+        case ND_NOT:
+        case ND_LOGICALNOT:
+        case ND_CAST:
+            return is_invariant(node->lhs, loop);
+        default:
+            return false;
+    }
+}
+
+// 移動する価値がある (演算を含み、定数だけでできていない) 式か
+static bool has_op(Node *node) {
+    NodeKind k = node->kind;
+    if (k == ND_NUM || k == ND_VAR || k == ND_ADDR) return false;
+    if (k == ND_DEREF || k == ND_NOT || k == ND_LOGICALNOT || k == ND_CAST) return has_op(node->lhs);
+    return true;
+}
+
+static bool has_var(Node *node) {
+    if (node == NULL) return false;
+    if (node->kind == ND_VAR) return true;
+    return has_var(node->lhs) || has_var(node->rhs);
+}
+
+static bool same_expr(Node *a, Node *b) {
+    if (a == NULL || b == NULL) return a == b;
+    if (a->kind != b->kind || a->val != b->val || a->var != b->var) return false;
+    if (a->kind == ND_CAST && a->type->size != b->type->size) return false;
+    return same_expr(a->lhs, b->lhs) && same_expr(a->rhs, b->rhs);
+}
+
+static Var *hoist_expr(Node *expr, Loop *loop) {
+    for (int i = 0; i < loop->hoisted->len; i++) {
+        if (same_expr(loop->hoisted->body[i], expr)) {
+            return loop->temps->body[i];
+        }
+    }
+
+    Type *ty = type_of(expr);
+    if (ty->kind == TYPE_ARRAY) {
+        ty = new_ptr_type(ty->ptr_to);
+    }
+    Var *tmp = new_temp_lvar(fn, ty);
+    Node *assign = new_assign(tmp, expr);
+    vec_push(loop->pre, assign);
+    vec_push(loop->hoisted, expr);
+    vec_push(loop->temps, tmp);
+    return tmp;
+}
+
+// 不変式を一時変数の参照に置き換える
+// is_addrのときはノード自体がアドレスとして使われるので置き換えない
+static void hoist(Node **np, bool is_addr, Loop *loop) {
+    Node *node = *np;
+    if (node == NULL) return;
+
+    if (!is_addr && has_op(node) && has_var(node) && is_invariant(node, loop)) {
+        Var *tmp = hoist_expr(node, loop);
+        *np = new_var_node(tmp);
+        return;
+    }
+
+    bool lhs_is_addr = node->kind == ND_ADDR || is_assignnode(node->kind) || node->kind == ND_STRUCT_MEMBER;
+    hoist(&node->lhs, lhs_is_addr, loop);
+    hoist(&node->rhs, false, loop);
+    hoist(&node->cond, false, loop);
+    hoist(&node->then, false, loop);
+    hoist(&node->els, false, loop);
+    hoist(&node->body, false, loop);
+    hoist(&node->init, false, loop);
+    hoist(&node->inc, false, loop);
+    if (node->args) {
+        for (int i = 0; i < node->args->len; i++) {
+            hoist((Node **)&node->args->body[i], false, loop);
+        }
+    }
+    if (node->stmts) {
+        for (int i = 0; i < node->stmts->len; i++) {
+            hoist((Node **)&node->stmts->body[i], false, loop);
+        }
+    }
+}
+
+static Node *optimize_loop(Node *node) {
+    Loop *loop = memory_alloc(sizeof(Loop));
+    loop->assigned = new_vec();
+    loop->pre = new_vec();
+    loop->hoisted = new_vec();
+    loop->temps = new_vec();
+    walk(node->cond, collect_loop_info, loop);
+    walk(node->body, collect_loop_info, loop);
+    walk(node->inc, collect_loop_info, loop);
+
+    Vector *post = new_vec();
+    promote_globals(node, loop, post);
+
+    // 置換した一時変数への代入もループ内の代入として数え直す
+    for (int i = 0; i < loop->pre->len; i++) {
+        Node *assign = loop->pre->body[i];
+        Var *tmp = assign->lhs->var;
+        Var *global = assign->rhs->var;
+        if (vec_contains(loop->assigned, global)) {
+            vec_union1(loop->assigned, tmp);
+        }
+    }
+
+    hoist(&node->cond, false, loop);
+    hoist(&node->body, false, loop);
+    hoist(&node->inc, false, loop);
+
+    if (loop->pre->len == 0) {
+        return node;
+    }
+
+    // 初期化式は前処理より先に評価する
+    Vector *stmts = new_vec();
+    if (node->init) {
+        vec_push(stmts, node->init);
+        node->init = NULL;
+    }
+    vec_concat(stmts, loop->pre);
+    vec_push(stmts, node);
+    vec_concat(stmts, post);
+    return new_suger(stmts);
+}
+
+// 式だけを包んだND_SUGER (添字の式など) か
+static bool is_wrapped_expr(Node *node) {
+    if (node->kind != ND_SUGER || node->stmts->len != 1) return false;
+    NodeKind k = ((Node *)node->stmts->body[0])->kind;
+    return k == ND_VAR || k == ND_NUM || k == ND_ADDR || k == ND_DEREF || k == ND_CAST || k == ND_NOT ||
+           k == ND_LOGICALNOT || (ND_ADD <= k && k <= ND_XOR && k != ND_ASSIGN);
+}
+
+// 内側のループから順に最適化する
+static void optimize_node(Node **np) {
+    Node *node = *np;
+    if (node == NULL) return;
+
+    // 不変式を見つけやすくするために、式を包んだだけのND_SUGERを外す
+    while (is_wrapped_expr(node)) {
+        node = *np = node->stmts->body[0];
+    }
+
+    optimize_node(&node->lhs);
+    optimize_node(&node->rhs);
+    optimize_node(&node->cond);
+    optimize_node(&node->then);
+    optimize_node(&node->els);
+    optimize_node(&node->body);
+    optimize_node(&node->init);
+    optimize_node(&node->inc);
+    if (node->args) {
+        for (int i = 0; i < node->args->len; i++) {
+            optimize_node((Node **)&node->args->body[i]);
+        }
+    }
+    if (node->stmts) {
+        for (int i = 0; i < node->stmts->len; i++) {
+            optimize_node((Node **)&node->stmts->body[i]);
+        }
+    }
+
+    if (node->kind == ND_FOR || node->kind == ND_WHILE) {
+        *np = optimize_loop(node);
+    }
+}
+
+void optimize() {
+    find_escaped_globals();
+    for (int i = 0; i < funcs->len; i++) {
+        fn = funcs->body[i];
+        if (fn->is_prototype) continue;
+
+        escaped_locals = new_vec();
+        find_escaped(fn->body);
+        optimize_node(&fn->body);
+    }
+}
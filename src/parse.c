@@ -9,6 +9,11 @@ static Function *cur_parse_func;
 static Vector *local_scope;
 static bool is_global = true;
 static StorageClass current_storage = UNKNOWN;
+static bool is_static_storage = false;  // 直前のtype_specifierにstaticがついていたか
+static int switch_depth = 0;            // caseとdefaultを書けるswitchの深さ
+
+// これ以上の大きさのローカル配列の初期化式は、定数部分を.rodataからまとめてコピーする
+#define INIT_TEMPLATE_MIN_SIZE 32
 
 static Type *find_typedef_alias(char *name);
 
@@ -25,6 +30,8 @@ static void create_lvar_from_params(Var *params);
 static Var *find_lvar(Token *tok);
 static Var *find_gvar(Token *tok);
 static Vector *new_node_init2(Initializer *init, Node *node);
+static Vector *new_node_init_template(Initializer *init, Node *node);
+static void init_image(Initializer *init, Var *var);
 
 /* AST */
 static Type *type_specifier();
@@ -76,7 +83,7 @@ static bool consume_nostep(int op) {
 
 // typedefに対応
 static bool consume_is_type_nostep(Token *tok) {
-    if (tok->kind == TK_TYPE) {
+    if (tok->kind == TK_TYPE || tok->kind == TK_STATIC) {
         return true;
     }
 
@@ -169,7 +176,6 @@ static Var *new_gvar(Token *tok, Type *type) {
     gvar->len = tok->len;
     gvar->type = type;
     gvar->is_global = true;
-    gvar->ginit = new_vec();
     globals = gvar;  // globalsを新しいグローバル変数に更新
     return gvar;
 }
@@ -214,6 +220,7 @@ static void create_lvar_from_params(Var *params) {
     // 引数はトップのローカルスコープになるのでnext_offsetで条件分岐が必要ない
     lvar->offset = locals->offset + sizeOfType(lvar->type);
     lvar->next = locals;
+    params->lvar = lvar;
 
     locals = lvar;
     create_lvar_from_params(params->next);
@@ -442,10 +449,16 @@ static void start_local_scope() {
     vec_push(local_scope, locals);
 }
 
-static void end_local_scope() {
+// スコープを閉じて、そのスコープで宣言したローカル変数を返す
+static Vector *end_local_scope() {
     Var *var = vec_pop(local_scope);
     var->next_offset = locals->next_offset > 0 ? locals->next_offset : locals->offset;
+    Vector *vars = new_vec();
+    for (Var *v = locals; v != var; v = v->next) {
+        vec_push(vars, v);
+    }
     locals = var;
+    return vars;
 }
 
 static Initializer *new_initializer(Var *var) {
@@ -756,6 +769,13 @@ static Node *new_assign(Node *lhs, Node *rhs) {
     return node;
 }
 
+// 左辺のアドレスを一度だけ求める代入 (rhsは lhs op x)
+static Node *new_assign_op(NodeKind kind, Node *lhs, Node *rhs) {
+    Node *node = new_assign(lhs, rhs);
+    node->kind = kind;
+    return node;
+}
+
 /* 数値ノードを作成 */
 static Node *new_node_num(long val) {
     Node *node = new_node(ND_NUM);
@@ -773,10 +793,126 @@ static Node *new_node_num(long val) {
  */
 static Node *new_node_init(Initializer *init, Node *node) {
     Node *n = new_node(ND_SUGER);
+    if (!is_global && init->children && sizeOfType(init->type) >= INIT_TEMPLATE_MIN_SIZE) {
+        n->stmts = new_node_init_template(init, node);
+        return n;
+    }
     n->stmts = new_node_init2(init, node);
     return n;
 }
 
+/*
+ * 大きいローカル配列の初期化
+ *
+ * int a[1000] = {1, 2, x};
+ *        ↓↓↓
+ * aの8バイト目から末尾までを0で埋める
+ * aの先頭8バイトに .rodata の {1, 2} をコピーする
+ * a[2] = x;
+ *
+ * 定数の要素はまとめてコピーし、定数でない要素だけを代入する。
+ * コピーするのは最後の0でない定数までで、残りは0で埋める。
+ */
+static void init_template2(Initializer *init, Type *ty, Node *node, int offset, char *data, int *len,
+                           Vector *stores) {
+    if (init->children) {
+        for (int i = 0; i < init->len; i++) {
+            Node *deref = new_node(ND_DEREF);
+            deref->lhs = new_add(node, new_node_num(i));
+            add_type(deref->lhs);
+            add_type(deref);
+            init_template2(init->children + i, ty->ptr_to, deref, offset + i * sizeOfType(ty->ptr_to), data, len,
+                           stores);
+        }
+        return;
+    }
+
+    if (!init->expr) return;
+    add_type(init->expr);
+    long val;
+    if (ty->kind == TYPE_ARRAY || ty->kind == TYPE_STRUCT || !eval_const(init->expr, &val)) {
+        vec_push(stores, new_assign(node, init->expr));
+        return;
+    }
+    if (val == 0) return;
+
+    // リトルエンディアンで要素の大きさだけ書き込む
+    int size = sizeOfType(ty);
+    for (int i = 0; i < size; i++) {
+        data[offset + i] = (char)(val >> (i * 8));
+    }
+    if (*len < offset + size) *len = offset + size;
+}
+
+static Vector *new_node_init_template(Initializer *init, Node *node) {
+    int size = sizeOfType(init->type);
+    char *data = memory_alloc(size);
+    int len = 0;
+    Vector *stores = new_vec();
+    init_template2(init, init->type, node, 0, data, &len, stores);
+
+    Vector *suger = new_vec();
+    if (len < size) {
+        Node *n = new_node(ND_ZERO_FILL);
+        n->lhs = node;
+        n->val = len;
+        vec_push(suger, n);
+    }
+    if (len > 0) {
+        Node *n = new_node(ND_TEMPLATE_COPY);
+        n->lhs = node;
+        n->str_literal = data;
+        n->val = len;
+        vec_push(suger, n);
+    }
+    vec_concat(suger, stores);
+    return suger;
+}
+
+/*
+ * グローバル変数の初期値
+ *
+ * int a[100] = {1, 2};
+ * char *p = "abc";
+ *        ↓↓↓
+ * aは先頭8バイトが {1, 2} で残りが0のバイト列になる
+ * pは8バイトの0と、位置0に.LCnのアドレスを置くrelocになる
+ *
+ * 要素ごとではなく変数ごとのバイト列にしておき、
+ * codegenで0の連続を.zero、残りを.ascii/.quadにまとめて出力する。
+ */
+static void init_image2(Initializer *init, Type *ty, int offset, Var *var) {
+    if (init->children) {
+        for (int i = 0; i < init->len; i++) {
+            init_image2(init->children + i, ty->ptr_to, offset + i * sizeOfType(ty->ptr_to), var);
+        }
+        return;
+    }
+
+    if (!init->expr) return;
+    GInit_el *g = eval(init->expr);
+
+    // ポインターかラベル
+    if (g->str) {
+        g->val = offset;
+        vec_push(var->relocs, g);
+        return;
+    }
+
+    // リトルエンディアンで要素の大きさだけ書き込む
+    int size = sizeOfType(ty);
+    if (size > 8) size = 8;
+    for (int i = 0; i < size; i++) {
+        var->init_data[offset + i] = (char)(g->val >> (i * 8));
+    }
+}
+
+static void init_image(Initializer *init, Var *var) {
+    var->init_data = memory_alloc(sizeOfType(var->type));
+    var->relocs = new_vec();
+    init_image2(init, var->type, 0, var);
+}
+
 static Vector *new_node_init2(Initializer *init, Node *node) {
     Vector *suger = new_vec();
 
@@ -792,12 +928,9 @@ static Vector *new_node_init2(Initializer *init, Node *node) {
         return suger;
     }
 
-    if (is_global) {
-        vec_push(init->var->ginit, eval(init->expr));
-    } else {
-        vec_push(suger, new_assign(node, init->expr));
-    }
-
+    // 省略された要素は0で初期化する
+    Node *expr = init->expr ? init->expr : new_node_num(0);
+    vec_push(suger, new_assign(node, expr));
     return suger;
 }
 
@@ -846,7 +979,9 @@ void program() {
         Type *type = type_specifier();
         if (is_func(token)) {
             is_global = false;
+            bool is_static = is_static_storage;
             Function *fn = func_define(type);
+            if (fn != NULL) fn->is_static = is_static;
             if (fn != NULL) vec_push(funcs, fn);
             is_global = true;
         } else {
@@ -877,6 +1012,10 @@ static Node *initialize(Initializer *init, Node *node) {
     bool is_index_omitted = node->var->type->kind == TYPE_ARRAY && node->var->type->array_size == 0;
     initialize2(init);
     if (is_index_omitted) node->var->offset += sizeOfType(node->var->type);
+    if (is_global) {
+        init_image(init, node->var);
+        return new_node(ND_NULL);
+    }
     return new_node_init(init, node);
 }
 
@@ -911,10 +1050,8 @@ static void initialize_array(Initializer *init) {
         expect('{');
         for (int i = 0; i < init->len; i++) {
             (init->children + i)->var = init->var;
-            if (consume_nostep('}')) {
-                (init->children + i)->expr = new_node_num(0);
-                continue;
-            }
+            // 省略された要素はexprをNULLのままにして0で初期化する
+            if (consume_nostep('}')) continue;
 
             if (i > 0) expect(',');
             (init->children + i)->type = ty->ptr_to;
@@ -939,10 +1076,7 @@ static void initialize_string(Initializer *init) {
     }
     for (int i = 0; i < init->len; i++) {
         (init->children + i)->var = init->var;
-        if (token->len <= i) {
-            (init->children + i)->expr = new_node_num(0);
-            continue;
-        }
+        if (token->len <= i) continue;
         (init->children + i)->type = ty->ptr_to;
         (init->children + i)->expr = new_node_num(token->str[i]);
     }
@@ -1009,20 +1143,37 @@ static Node *declaration_var(Type *type) {
     return node;
 }
 
+// この宣言で追加されたグローバル変数 (globalsの先頭からprevの手前まで) にstaticをつける
+static void mark_static(Var *prev, bool is_static) {
+    if (!is_static) return;
+    for (Var *var = globals; var != prev; var = var->next) {
+        var->is_static = true;
+    }
+}
+
 /*
  *  <declaration> = <type_specifier> <declaration_var> ("," <declaration_var>)*
  */
 static Node *declaration(Type *type) {
+    // 初期化式の中のtype_specifierで上書きされる前に取っておく
+    bool is_static = is_static_storage;
+    if (is_static && !is_global) {
+        error("declaration() failure: 関数内のstatic変数はサポートしていません");
+    }
+    Var *prev = globals;
+
     Node *node = declaration_var(type);
     if (consume_nostep(';')) {
         if (node->kind == ND_VAR && current_storage == STORAGE_TYPEDEF) {
             Typedef_alias *ta = new_typedef_alias(node->var->name, node->var->type);
             vec_push(typedef_alias, ta);
+            node->var->is_typedef = true;
             current_storage = UNKNOWN;
         } else if (node->kind == ND_VAR && current_storage == STORAGE_EXTERN) {
             node->var->is_extern = true;
             current_storage = UNKNOWN;
         }
+        mark_static(prev, is_static);
         return node;
     }
 
@@ -1039,11 +1190,13 @@ static Node *declaration(Type *type) {
         if (tmp_node->kind == ND_VAR && current_storage == STORAGE_TYPEDEF) {
             Typedef_alias *ta = new_typedef_alias(tmp_node->var->name, tmp_node->var->type);
             vec_push(typedef_alias, ta);
+            tmp_node->var->is_typedef = true;
         } else if (tmp_node->kind == ND_VAR && current_storage == STORAGE_EXTERN) {
             tmp_node->var->is_extern = true;
         }
     }
     current_storage = UNKNOWN;
+    mark_static(prev, is_static);
 
     return n;
 }
@@ -1063,7 +1216,7 @@ Type *struct_declaration(Type *type) {
 }
 
 /*
- *  <storage_class>  = "typedef" | "extern"
+ *  <storage_class>  = "typedef" | "extern" | "static"
  *  <type_specifier> = <storage_class>? "int"
  *                   | <storage_class>? "char"
  *                   | <storage_class>? "void"
@@ -1071,6 +1224,9 @@ Type *struct_declaration(Type *type) {
  *                   | <storage_class>? "struct" <ident> "{" <struct_declaration>* "}"
  */
 static Type *type_specifier() {
+    // staticは関数とグローバル変数で外部に公開しないことを表す
+    is_static_storage = consume(TK_STATIC);
+
     if (consume(TK_TYPEDEF))
         current_storage = STORAGE_TYPEDEF;
     else if (consume(TK_EXTERN)) {
@@ -1405,18 +1561,21 @@ static Node *compound_stmt() {
         }
         vec_push(node->stmts, n);
     }
-    end_local_scope();
+    node->scope_vars = end_local_scope();
 
     return node;
 }
 
-// TODO: do~while,switch,else if
+// TODO: do~while,else if
 /*
  *  <stmt> = <expr>? ";"
  *         | "return" <expr>? ";"
  *         | "if" "(" <expr> ")" <stmt> ("else" <stmt>)?
  *         | "while" "(" <expr> ")" <stmt>
  *         | "for" "(" <expr>? ";" <expr>? ";" <expr>? ")" <stmt>
+ *         | "switch" "(" <expr> ")" <stmt>
+ *         | "case" <conditional> ":" <stmt>
+ *         | "default" ":" <stmt>
  *         | ("continue" | "break")
  *         | <compound_stmt>
  */
@@ -1471,7 +1630,34 @@ static Node *stmt() {
             expect(')');
         }
         node->body = stmt();
-        end_local_scope();
+        node->scope_vars = end_local_scope();
+    } else if (consume(TK_SWITCH)) {
+        node = new_node(ND_SWITCH);
+        expect('(');
+        node->cond = expr();
+        expect(')');
+        switch_depth++;
+        node->body = stmt();
+        switch_depth--;
+    } else if (consume(TK_CASE)) {
+        if (switch_depth == 0) {
+            error("stmt() failure: switchの外でcaseを使用しています");
+        }
+        node = new_node(ND_CASE);
+        GInit_el *el = eval(conditional());
+        if (el->str) {
+            error("stmt() failure: caseの値が整数の定数ではありません");
+        }
+        node->val = el->val;
+        expect(':');
+        node->lhs = stmt();
+    } else if (consume(TK_DEFAULT)) {
+        if (switch_depth == 0) {
+            error("stmt() failure: switchの外でdefaultを使用しています");
+        }
+        node = new_node(ND_DEFAULT);
+        expect(':');
+        node->lhs = stmt();
     } else if (consume_nostep('{')) {
         node = compound_stmt();
     } else if (consume(TK_BREAK)) {
@@ -1528,25 +1714,25 @@ static Node *assign() {
     if (consume('=')) {
         node = new_assign(node, assign());
     } else if (consume(TK_ADD_EQ)) {
-        node = new_assign(node, new_add(node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_add(node, conditional()));
     } else if (consume(TK_SUB_EQ)) {
-        node = new_assign(node, new_sub(node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_sub(node, conditional()));
     } else if (consume(TK_MUL_EQ)) {
-        node = new_assign(node, new_mul(node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_mul(node, conditional()));
     } else if (consume(TK_DIV_EQ)) {
-        node = new_assign(node, new_div(node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_div(node, conditional()));
     } else if (consume(TK_MOD_EQ)) {
-        node = new_assign(node, new_mod(node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_mod(node, conditional()));
     } else if (consume(TK_AND_EQ)) {
-        node = new_assign(node, new_binop(ND_AND, node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_binop(ND_AND, node, conditional()));
     } else if (consume(TK_OR_EQ)) {
-        node = new_assign(node, new_binop(ND_OR, node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_binop(ND_OR, node, conditional()));
     } else if (consume(TK_XOR_EQ)) {
-        node = new_assign(node, new_binop(ND_XOR, node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_binop(ND_XOR, node, conditional()));
     } else if (consume(TK_LSHIFT_EQ)) {
-        node = new_assign(node, new_binop(ND_LSHIFT, node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_binop(ND_LSHIFT, node, conditional()));
     } else if (consume(TK_RSHIFT_EQ)) {
-        node = new_assign(node, new_binop(ND_RSHIFT, node, conditional()));
+        node = new_assign_op(ND_ASSIGN_OP, node, new_binop(ND_RSHIFT, node, conditional()));
     }
     return node;
 }
@@ -1795,19 +1981,17 @@ static Node *unary() {
         }
     } else if (consume(TK_INC)) {
         Node *node = unary();
-        return new_assign(node, new_add(node, new_node_num(1)));
+        return new_assign_op(ND_ASSIGN_OP, node, new_add(node, new_node_num(1)));
     } else if (consume(TK_DEC)) {
         Node *node = unary();
-        return new_assign(node, new_sub(node, new_node_num(1)));
+        return new_assign_op(ND_ASSIGN_OP, node, new_sub(node, new_node_num(1)));
     }
 
     Node *node = postfix();
     if (consume(TK_INC)) {
-        // 先に+1して保存してから-1する
-        return new_sub(new_assign(node, new_add(node, new_node_num(1))), new_node_num(1));
+        return new_assign_op(ND_POST_INCDEC, node, new_add(node, new_node_num(1)));
     } else if (consume(TK_DEC)) {
-        // 先に+-1して保存してから+1する
-        return new_add(new_assign(node, new_sub(node, new_node_num(1))), new_node_num(1));
+        return new_assign_op(ND_POST_INCDEC, node, new_sub(node, new_node_num(1)));
     }
 
     return node;
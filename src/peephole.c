@@ -0,0 +1,305 @@
+#include "kcc.h"
+
+/*
+ * 生成したアセンブリに対するのぞき穴最適化
+ *
+ * 出力済みの命令列の末尾に1行ずつ追加しながら、末尾の数命令を
+ * 規則表と照合して書き換える。書き換えた結果にも続けて規則を適用する。
+ *
+ * コード生成の約束として、条件分岐の直後と分岐先ではraxの値は使われない。
+ */
+
+typedef struct Insn Insn;
+typedef struct Rule Rule;
+
+// 命令を分解したもの
+struct Insn {
+    char op[16];
+    char dst[64];
+    char src[64];
+    int nopr;  // オペランドの数 (ラベルやディレクティブは-1)
+};
+
+struct Rule {
+    char *name;
+    bool (*apply)(Vector *out);
+    int hits;
+};
+
+static bool parse_insn(char *line, Insn *insn) {
+    memset(insn, 0, sizeof(Insn));
+    insn->nopr = -1;
+    if (line == NULL || strncmp(line, "  ", 2) != 0 || line[2] == '.') {
+        return false;
+    }
+
+    char *p = line + 2;
+    char *q = strchr(p, ' ');
+    if (q == NULL) {
+        snprintf(insn->op, sizeof(insn->op), "%s", p);
+        insn->nopr = 0;
+        return true;
+    }
+    snprintf(insn->op, sizeof(insn->op), "%.*s", (int)(q - p), p);
+    while (*q == ' ') q++;
+
+    char *comma = strstr(q, ", ");
+    if (comma == NULL) {
+        snprintf(insn->dst, sizeof(insn->dst), "%s", q);
+        insn->nopr = 1;
+        return true;
+    }
+    snprintf(insn->dst, sizeof(insn->dst), "%.*s", (int)(comma - q), q);
+    snprintf(insn->src, sizeof(insn->src), "%s", comma + 2);
+    insn->nopr = 2;
+    return true;
+}
+
+// 末尾からn番目 (0が最後) の行
+static char *tail(Vector *out, int n) {
+    if (out->len <= n) return NULL;
+    return out->body[out->len - 1 - n];
+}
+
+static bool tail_insn(Vector *out, int n, Insn *insn) {
+    return parse_insn(tail(out, n), insn);
+}
+
+static bool is_insn(Insn *insn, char *op, int nopr) {
+    return insn->nopr == nopr && strcmp(insn->op, op) == 0;
+}
+
+// 末尾のn行をlineで置き換える (lineがNULLなら削除のみ)
+static void replace_tail(Vector *out, int n, char *line) {
+    for (int i = 0; i < n; i++) {
+        vec_pop(out);
+    }
+    if (line) vec_push(out, line);
+}
+
+static char *reg_family[][5] = {
+    {"rax", "eax", "ax", "al", "ah"},
+    {"rbx", "ebx", "bx", "bl", "bh"},
+    {"rdi", "edi", "di", "dil", NULL},
+    {"rsi", "esi", "si", "sil", NULL},
+    {"rdx", "edx", "dx", "dl", "dh"},
+    {"rcx", "ecx", "cx", "cl", "ch"},
+    {"rbp", "ebp", "bp", "bpl", NULL},
+    {"rsp", "esp", "sp", "spl", NULL},
+};
+
+// 文字列opndにレジスタregの別名(eax, alなど)が現れるか
+static bool mentions_reg(char *opnd, char *reg) {
+    for (size_t i = 0; i < sizeof(reg_family) / sizeof(reg_family[0]); i++) {
+        if (strcmp(reg_family[i][0], reg) != 0) continue;
+
+        for (int j = 0; j < 5 && reg_family[i][j]; j++) {
+            char *name = reg_family[i][j];
+            int len = strlen(name);
+            for (char *p = strstr(opnd, name); p; p = strstr(p + 1, name)) {
+                bool head = p == opnd || !is_alnum(p[-1]);
+                bool rest = !is_alnum(p[len]);
+                if (head && rest) return true;
+            }
+        }
+        return false;
+    }
+
+    // 一覧にないレジスタ (r8~r15) は接頭辞で判定する
+    return strstr(opnd, reg) != NULL;
+}
+
+// 暗黙のオペランドを持たず、スタックにも触れない命令か
+static bool is_simple_insn(Insn *insn) {
+    static char *ops[] = {
+        "mov", "movsx", "movsxd", "movzx", "movzb", "lea",
+        "add", "sub", "and", "or", "xor", "not", "neg", "cmp", "test",
+        "sete", "setne", "setl", "setle", "setg", "setge"};
+
+    if (insn->nopr < 1) return false;
+    if (mentions_reg(insn->dst, "rsp") || mentions_reg(insn->src, "rsp")) return false;
+    for (size_t i = 0; i < sizeof(ops) / sizeof(char *); i++) {
+        if (strcmp(insn->op, ops[i]) == 0) return true;
+    }
+    return false;
+}
+
+static bool is_reg64(char *s) {
+    static char *regs[] = {
+        "rax", "rbx", "rcx", "rdx", "rsi", "rdi",
+        "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+
+    for (size_t i = 0; i < sizeof(regs) / sizeof(char *); i++) {
+        if (strcmp(s, regs[i]) == 0) return true;
+    }
+    return false;
+}
+
+/* ~ 規則 ~ */
+
+// push rax; pop rax -> (削除)
+static bool push_pop_same(Vector *out) {
+    Insn a, b;
+    if (!tail_insn(out, 1, &a) || !tail_insn(out, 0, &b)) return false;
+    if (!is_insn(&a, "push", 1) || !is_insn(&b, "pop", 1)) return false;
+    if (strcmp(a.dst, b.dst) != 0) return false;
+
+    replace_tail(out, 2, NULL);
+    return true;
+}
+
+// push rax; pop rdi -> mov rdi, rax
+static bool push_pop_mov(Vector *out) {
+    Insn a, b;
+    if (!tail_insn(out, 1, &a) || !tail_insn(out, 0, &b)) return false;
+    if (!is_insn(&a, "push", 1) || !is_insn(&b, "pop", 1)) return false;
+    if (!is_reg64(a.dst) || !is_reg64(b.dst)) return false;
+
+    replace_tail(out, 2, format("  mov %s, %s", b.dst, a.dst));
+    return true;
+}
+
+// push rax; mov rdi, 1; pop rax -> mov rdi, 1
+static bool push_insn_pop(Vector *out) {
+    Insn a, b, c;
+    if (!tail_insn(out, 2, &a) || !tail_insn(out, 1, &b) || !tail_insn(out, 0, &c)) return false;
+    if (!is_insn(&a, "push", 1) || !is_insn(&c, "pop", 1)) return false;
+    if (strcmp(a.dst, c.dst) != 0 || !is_simple_insn(&b)) return false;
+    if (mentions_reg(b.dst, a.dst) || mentions_reg(b.src, a.dst)) return false;
+
+    char *line = tail(out, 1);
+    replace_tail(out, 3, line);
+    return true;
+}
+
+// mov rax, 1; mov rdi, rax; pop rax -> mov rdi, 1; pop rax
+static bool forward_mov(Vector *out) {
+    Insn a, b, c;
+    if (!tail_insn(out, 2, &a) || !tail_insn(out, 1, &b) || !tail_insn(out, 0, &c)) return false;
+    if (!is_insn(&c, "pop", 1) || strcmp(c.dst, "rax") != 0) return false;
+    if (!is_insn(&b, "mov", 2) || strcmp(b.src, "rax") != 0 || !is_reg64(b.dst)) return false;
+    if (!(is_insn(&a, "mov", 2) || is_insn(&a, "lea", 2)) || strcmp(a.dst, "rax") != 0) return false;
+
+    char *line = format("  %s %s, %s", a.op, b.dst, a.src);
+    char *pop = tail(out, 0);
+    replace_tail(out, 3, line);
+    vec_push(out, pop);
+    return true;
+}
+
+// mov rax, rbp; sub rax, 8 -> lea rax, [rbp-8]
+static bool frame_addr(Vector *out) {
+    Insn a, b;
+    if (!tail_insn(out, 1, &a) || !tail_insn(out, 0, &b)) return false;
+    if (!is_insn(&a, "mov", 2) || strcmp(a.dst, "rax") != 0 || strcmp(a.src, "rbp") != 0) return false;
+    if (!is_insn(&b, "sub", 2) || strcmp(b.dst, "rax") != 0 || !isdigit(b.src[0])) return false;
+
+    replace_tail(out, 2, format("  lea rax, [rbp-%s]", b.src));
+    return true;
+}
+
+// lea rax, [rbp-8]; movsxd rax, DWORD PTR [rax] -> movsxd rax, DWORD PTR [rbp-8]
+static bool fold_load(Vector *out) {
+    Insn a, b;
+    if (!tail_insn(out, 1, &a) || !tail_insn(out, 0, &b)) return false;
+    if (!is_insn(&a, "lea", 2) || strcmp(a.dst, "rax") != 0) return false;
+    if (!is_insn(&b, "mov", 2) && !is_insn(&b, "movsx", 2) && !is_insn(&b, "movsxd", 2)) return false;
+    if (strcmp(b.dst, "rax") != 0) return false;
+
+    // 読みこむ幅の指定 (BYTE PTRなど) は残してアドレスだけ置き換える
+    int len = strlen(b.src);
+    if (len < 5 || strcmp(b.src + len - 5, "[rax]") != 0) return false;
+
+    replace_tail(out, 2, format("  %s rax, %.*s%s", b.op, len - 5, b.src, a.src));
+    return true;
+}
+
+// cmp rax, 0 -> test rax, rax
+static bool cmp_zero(Vector *out) {
+    Insn a;
+    if (!tail_insn(out, 0, &a)) return false;
+    if (!is_insn(&a, "cmp", 2) || !is_reg64(a.dst) || strcmp(a.src, "0") != 0) return false;
+
+    replace_tail(out, 1, format("  test %s, %s", a.dst, a.dst));
+    return true;
+}
+
+static char *negate_cc(char *cc) {
+    static char *pairs[][2] = {{"e", "ne"}, {"ne", "e"}, {"l", "ge"}, {"ge", "l"}, {"le", "g"}, {"g", "le"}};
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        if (strcmp(pairs[i][0], cc) == 0) return pairs[i][1];
+    }
+    return NULL;
+}
+
+// setl al; movzb rax, al; test rax, rax; je L -> jge L
+static bool setcc_branch(Vector *out) {
+    Insn a, b, c, d;
+    if (!tail_insn(out, 3, &a) || !tail_insn(out, 2, &b) || !tail_insn(out, 1, &c) || !tail_insn(out, 0, &d)) return false;
+    if (strncmp(a.op, "set", 3) != 0 || a.nopr != 1 || strcmp(a.dst, "al") != 0) return false;
+    if (!is_insn(&b, "movzb", 2) || strcmp(b.dst, "rax") != 0 || strcmp(b.src, "al") != 0) return false;
+    if (!is_insn(&c, "test", 2) || strcmp(c.dst, "rax") != 0 || strcmp(c.src, "rax") != 0) return false;
+    if (!is_insn(&d, "je", 1) && !is_insn(&d, "jne", 1)) return false;
+
+    char *cc = a.op + 3;
+    if (strcmp(d.op, "je") == 0) {
+        cc = negate_cc(cc);
+    }
+    if (cc == NULL) return false;
+
+    replace_tail(out, 4, format("  j%s %s", cc, d.dst));
+    return true;
+}
+
+// jmp L; L: -> L:
+static bool jump_to_next(Vector *out) {
+    Insn a;
+    char *label = tail(out, 0);
+    if (!tail_insn(out, 1, &a) || label == NULL) return false;
+    if (!is_insn(&a, "jmp", 1)) return false;
+
+    int len = strlen(a.dst);
+    if (strncmp(label, a.dst, len) != 0 || strcmp(label + len, ":") != 0) return false;
+
+    replace_tail(out, 2, label);
+    return true;
+}
+
+static Rule rules[] = {
+    {"push-pop-same", push_pop_same, 0},
+    {"push-pop-mov", push_pop_mov, 0},
+    {"push-insn-pop", push_insn_pop, 0},
+    {"forward-mov", forward_mov, 0},
+    {"frame-addr", frame_addr, 0},
+    {"fold-load", fold_load, 0},
+    {"cmp-zero", cmp_zero, 0},
+    {"setcc-branch", setcc_branch, 0},
+    {"jump-to-next", jump_to_next, 0},
+};
+
+static int rules_len = sizeof(rules) / sizeof(Rule);
+
+Vector *peephole(Vector *code) {
+    Vector *out = new_vec();
+    for (int i = 0; i < code->len; i++) {
+        vec_push(out, code->body[i]);
+
+        // どの規則も当てはまらなくなるまで繰り返す
+        for (int r = 0; r < rules_len;) {
+            if (rules[r].apply(out)) {
+                rules[r].hits++;
+                r = 0;
+            } else {
+                r++;
+            }
+        }
+    }
+    return out;
+}
+
+void print_peephole_stats() {
+    fprintf(stderr, "peephole rule hits:\n");
+    for (int i = 0; i < rules_len; i++) {
+        fprintf(stderr, "  %-16s %d\n", rules[i].name, rules[i].hits);
+    }
+}
@@ -0,0 +1,283 @@
+#include "kcc.h"
+
+/*
+ * ローカル変数のレジスタ割り当て (線形走査法)
+ *
+ * アドレスを取られないスカラー型のローカル変数を対象にする。
+ * ASTをコード生成と同じ順に走査して各変数の生存区間を求め、
+ * 開始位置の順にレジスタを割り当てる。足りなくなったら
+ * 区間の終わりが最も遠い変数をメモリに追い出す。
+ *
+ * 式の途中結果は従来通りスタックマシンで扱う。
+ */
+
+typedef struct Interval Interval;
+
+// 生存区間 (varがNULLの場合はループの範囲か関数呼び出しの位置)
+struct Interval {
+    Var *var;
+    int start;
+    int end;
+    bool across_call;
+    bool read_before_def;  // 代入より先に読まれる
+};
+
+// 割り当て可能なレジスタ (0番は割り当てなし)
+// r10, r11は関数呼び出しで破壊されるので、呼び出しを跨がない変数にだけ使う
+// rbpはフレームポインタを使わない関数でだけ使う (最後に置く)
+static char *allocreg[] = {NULL, "r10", "r11", "rbx", "r12", "r13", "r14", "r15", "rbp"};
+static int allocreg_len = sizeof(allocreg) / sizeof(char *);
+static int first_callee_saved = 3;
+static int nregs;  // 割り当てに使うレジスタの数 (0番を含む)
+
+static int pos;
+static Vector *intervals;  // 変数の生存区間
+static Vector *loops;      // ループの範囲
+static Vector *calls;      // 関数呼び出しの位置
+static Vector *escaped;    // アドレスを取られた変数
+
+char *reg_name(int reg) {
+    if (reg <= 0 || reg >= allocreg_len) {
+        error("reg_name() failure: 不正なレジスター番号です [%d]", reg);
+    }
+    return allocreg[reg];
+}
+
+static bool is_callee_saved(int reg) {
+    return reg >= first_callee_saved;
+}
+
+static Interval *new_interval(Var *var, int start) {
+    Interval *iv = memory_alloc(sizeof(Interval));
+    iv->var = var;
+    iv->start = start;
+    iv->end = start;
+    return iv;
+}
+
+static Interval *find_interval(Var *var) {
+    for (int i = 0; i < intervals->len; i++) {
+        Interval *iv = intervals->body[i];
+        if (iv->var == var) {
+            return iv;
+        }
+    }
+    return NULL;
+}
+
+static void use_var(Var *var, bool is_addr, bool is_def) {
+    if (var->is_global) return;
+
+    if (is_addr) {
+        vec_union1(escaped, var);
+    }
+
+    Interval *iv = find_interval(var);
+    if (iv == NULL) {
+        iv = new_interval(var, pos);
+        iv->read_before_def = !is_def;
+        vec_push(intervals, iv);
+    }
+    iv->end = pos;
+}
+
+static void scan(Node *node, bool is_addr);
+
+static void scan_vec(Vector *v, bool is_addr) {
+    if (v == NULL) return;
+    for (int i = 0; i < v->len; i++) {
+        scan(v->body[i], is_addr);
+    }
+}
+
+// コード生成の順に番号を振りながら変数の出現位置を記録する
+static void scan(Node *node, bool is_addr) {
+    if (node == NULL) return;
+
+    if (node->kind == ND_FOR || node->kind == ND_WHILE || node->kind == ND_VECTOR_LOOP) {
+        scan(node->init, is_addr);
+        Interval *loop = new_interval(NULL, pos);
+        scan(node->cond, is_addr);
+        scan(node->body, is_addr);
+        scan_vec(node->stmts, is_addr);
+        scan(node->inc, is_addr);
+        loop->end = pos++;
+        vec_push(loops, loop);
+        return;
+    }
+
+    if (node->kind == ND_INLINE) {
+        // 引数の代入、本体、返り値の順に生成される
+        scan_vec(node->stmts, is_addr);
+        scan(node->body, is_addr);
+        scan(node->lhs, is_addr);
+        pos++;
+        return;
+    }
+
+    if (node->kind == ND_ADDR) {
+        // &の先にある変数はメモリに置く必要がある
+        is_addr = true;
+    }
+
+    if (node->kind == ND_VAR) {
+        use_var(node->var, is_addr, false);
+        pos++;
+        return;
+    }
+
+    if (is_assignnode(node->kind) && node->lhs->kind == ND_VAR) {
+        scan(node->rhs, is_addr);
+        use_var(node->lhs->var, is_addr, true);
+        pos++;
+        return;
+    }
+
+    scan(node->init, is_addr);
+    scan(node->cond, is_addr);
+    scan(node->lhs, is_addr);
+    scan(node->rhs, is_addr);
+    scan(node->then, is_addr);
+    scan(node->els, is_addr);
+    scan(node->body, is_addr);
+    scan(node->inc, is_addr);
+    scan_vec(node->args, is_addr);
+    scan_vec(node->stmts, is_addr);
+
+    if (node->kind == ND_CALL) {
+        vec_push(calls, new_interval(NULL, pos));
+    }
+    pos++;
+}
+
+static bool is_allocatable(Interval *iv) {
+    Var *var = iv->var;
+    if (vec_contains(escaped, var)) return false;
+    // 初期化前に読まれる変数は-O0と同じくメモリに置く
+    if (iv->read_before_def) return false;
+
+    TypeKind kind = var->type->kind;
+    return is_integertype(kind) || kind == TYPE_PTR;
+}
+
+// ループと重なる区間はループ全体に広げる (後方への分岐で値が生き続けるため)
+static void extend_to_loops(Interval *iv) {
+    for (int i = 0; i < loops->len; i++) {
+        Interval *loop = loops->body[i];
+        if (iv->start <= loop->end && loop->start <= iv->end) {
+            if (loop->start < iv->start) iv->start = loop->start;
+            if (loop->end > iv->end) iv->end = loop->end;
+        }
+    }
+
+    for (int i = 0; i < calls->len; i++) {
+        Interval *call = calls->body[i];
+        if (iv->start <= call->start && call->start <= iv->end) {
+            iv->across_call = true;
+            break;
+        }
+    }
+}
+
+static int compare_start(const void *p, const void *q) {
+    Interval *a = *(Interval **)p, *b = *(Interval **)q;
+    return a->start - b->start;
+}
+
+static int find_free_reg(bool *used, bool across_call) {
+    int from = across_call ? first_callee_saved : 1;
+    for (int r = from; r < nregs; r++) {
+        if (!used[r]) return r;
+    }
+    return 0;
+}
+
+void alloc_regs(Function *fn) {
+    nregs = fn->omit_frame_pointer ? allocreg_len : allocreg_len - 1;
+    pos = 1;
+    intervals = new_vec();
+    loops = new_vec();
+    calls = new_vec();
+    escaped = new_vec();
+
+    // 引数は関数の入り口から生きている
+    for (Var *param = fn->params; param; param = param->next) {
+        if (param->lvar) {
+            vec_push(intervals, new_interval(param->lvar, 0));
+        }
+    }
+
+    scan(fn->body, false);
+
+    Vector *candidates = new_vec();
+    for (int i = 0; i < intervals->len; i++) {
+        Interval *iv = intervals->body[i];
+        if (!is_allocatable(iv)) continue;
+        extend_to_loops(iv);
+        vec_push(candidates, iv);
+    }
+    qsort(candidates->body, candidates->len, sizeof(void *), compare_start);
+
+    bool *used = memory_alloc(sizeof(bool) * allocreg_len);
+    Vector *active = new_vec();
+
+    for (int i = 0; i < candidates->len; i++) {
+        Interval *iv = candidates->body[i];
+
+        // 終わった区間のレジスタを解放する
+        for (int j = 0; j < active->len; j++) {
+            Interval *a = active->body[j];
+            if (a->end < iv->start) {
+                used[a->var->reg] = false;
+                vec_delete(active, j);
+                j--;
+            }
+        }
+
+        int r = find_free_reg(used, iv->across_call);
+        if (r) {
+            iv->var->reg = r;
+            used[r] = true;
+            vec_push(active, iv);
+            continue;
+        }
+
+        // 空きがなければ、最も遠くまで生きる区間をメモリに追い出す
+        int spill = -1;
+        for (int j = 0; j < active->len; j++) {
+            Interval *a = active->body[j];
+            if (iv->across_call && !is_callee_saved(a->var->reg)) continue;
+            if (spill == -1 || ((Interval *)active->body[spill])->end < a->end) {
+                spill = j;
+            }
+        }
+
+        if (spill != -1 && ((Interval *)active->body[spill])->end > iv->end) {
+            Interval *s = active->body[spill];
+            iv->var->reg = s->var->reg;
+            s->var->reg = 0;
+            vec_delete(active, spill);
+            vec_push(active, iv);
+        }
+    }
+
+    // 使用したcallee-savedレジスタはプロローグで退避する
+    fn->saved_regs = new_vec();
+    for (int i = 0; i < candidates->len; i++) {
+        Interval *iv = candidates->body[i];
+        if (iv->var->reg && is_callee_saved(iv->var->reg)) {
+            vec_union1(fn->saved_regs, allocreg[iv->var->reg]);
+        }
+    }
+
+    // 変数に割り当てなかったcaller-savedレジスタは式の評価に使う
+    fn->cache_regs = new_vec();
+    for (int r = 1; r < first_callee_saved; r++) {
+        bool used = false;
+        for (int i = 0; i < candidates->len; i++) {
+            Interval *iv = candidates->body[i];
+            if (iv->var->reg == r) used = true;
+        }
+        if (!used) vec_push(fn->cache_regs, allocreg[r]);
+    }
+}
@@ -9,7 +9,7 @@ static char escape_letters[][2] = {
     {'n', 10},
     {'r', 13},
     {'t', 9},
-    {'v', 12},
+    {'v', 11},
     {'\\', 92},
     {'\'', 39},
     {'"', 34},
@@ -24,6 +24,19 @@ Token *new_token(int kind, Token *cur, char *str, int len) {
     return tok;
 }
 
+// 同じ内容の文字列リテラルは同じラベルを使う
+static void intern_string_literal(Token *tok) {
+    for (int i = 0; i < string_literal->len; i++) {
+        Token *t = string_literal->body[i];
+        if (t->len == tok->len && strcmp(t->str, tok->str) == 0) {
+            tok->str_literal_index = t->str_literal_index;
+            return;
+        }
+    }
+    tok->str_literal_index = string_literal->len;
+    vec_push(string_literal, tok);
+}
+
 char escape_single_letter(char *p) {
     for (int i = 0; i < sizeof(escape_letters) / sizeof(char[2]); i++) {
         if (escape_letters[i][0] == *p) {
@@ -73,7 +86,8 @@ Token *tokenize(char *p) {
             continue;
         }
 
-        if (strncmp(p, "static", 6) == 0) {
+        if (strncmp(p, "static", 6) == 0 && !is_alnum(p[6])) {
+            cur = new_token(TK_STATIC, cur, p, 6);
             p += 6;
             continue;
         }
@@ -257,8 +271,7 @@ Token *tokenize(char *p) {
             p++;
             cur->str = my_strndup(q, len);
             cur->len = strlen(cur->str);
-            cur->str_literal_index = string_literal->len;
-            vec_push(string_literal, cur);
+            intern_string_literal(cur);
             continue;
         }
 
@@ -311,6 +324,24 @@ Token *tokenize(char *p) {
             continue;
         }
 
+        if (strncmp(p, "switch", 6) == 0 && !is_alnum(p[6])) {
+            cur = new_token(TK_SWITCH, cur, p, 6);
+            p += 6;
+            continue;
+        }
+
+        if (strncmp(p, "case", 4) == 0 && !is_alnum(p[4])) {
+            cur = new_token(TK_CASE, cur, p, 4);
+            p += 4;
+            continue;
+        }
+
+        if (strncmp(p, "default", 7) == 0 && !is_alnum(p[7])) {
+            cur = new_token(TK_DEFAULT, cur, p, 7);
+            p += 7;
+            continue;
+        }
+
         if (strncmp(p, "break", 5) == 0 && !is_alnum(p[5])) {
             cur = new_token(TK_BREAK, cur, p, 5);
             p += 5;
@@ -39,6 +39,23 @@ int sizeOfType(Type *ty) {
     return ty->size;
 }
 
+// 変数を置くアドレスの境界 (8バイトまで)
+int alignOfType(Type *ty) {
+    if (ty->kind == TYPE_ARRAY) {
+        return alignOfType(ty->ptr_to);
+    }
+    if (ty->kind == TYPE_STRUCT) {
+        int align = 1;
+        for (Var *m = ty->member; m; m = m->next) {
+            int a = alignOfType(m->type);
+            if (align < a) align = a;
+        }
+        return align;
+    }
+    if (ty->size >= 8) return 8;
+    return ty->size > 0 ? ty->size : 1;
+}
+
 bool is_same_type(Type *ty1, Type *ty2) {
     if (ty1 == NULL || ty2 == NULL) {
         // NULL == NULLで等しい型
@@ -102,6 +119,14 @@ bool is_relationalnode(NodeKind kind) {
         kind == ND_LE);
 }
 
+// 左辺の変数を書き換えるノードか
+bool is_assignnode(NodeKind kind) {
+    return (
+        kind == ND_ASSIGN ||
+        kind == ND_ASSIGN_OP ||
+        kind == ND_POST_INCDEC);
+}
+
 TypeKind large_numtype(Type *t1, Type *t2) {
     if (!is_integertype(t1->kind) || !is_integertype(t2->kind)) {
         error("整数の型ではありません。\n");
@@ -208,7 +233,7 @@ void add_type(Node *node) {
         return;
     }
 
-    if (node->kind == ND_ASSIGN) {
+    if (is_assignnode(node->kind)) {
         if (node->rhs->type == NULL || node->lhs->type == NULL) {
             fprintf(stderr, "[node->lhs->type]\n");
             debug_type(node->lhs->type, 0);
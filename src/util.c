@@ -99,6 +99,26 @@ char *my_strndup(char *s, size_t n) {
     return p;
 }
 
+// printfと同じ書式で文字列を作る
+char *vformat(char *fmt, va_list ap) {
+    va_list ap2;
+    va_copy(ap2, ap);
+    int len = vsnprintf(NULL, 0, fmt, ap2);
+    va_end(ap2);
+
+    char *buf = memory_alloc(len + 1);
+    vsnprintf(buf, len + 1, fmt, ap);
+    return buf;
+}
+
+char *format(char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    char *buf = vformat(fmt, ap);
+    va_end(ap);
+    return buf;
+}
+
 void swap(void **p, void **q) {
     void *tmp = *p;
     *p = *q;
@@ -125,3 +145,175 @@ void copy_func(Function *to, Function *from) {
     to->ret_type = from->ret_type;
     to->is_prototype = from->is_prototype;
 }
+
+static void find_cases(Node *node, Vector *cases, Node **default_case) {
+    if (node == NULL || node->kind == ND_SWITCH) {
+        // 内側のswitchのcaseは含めない
+        return;
+    }
+
+    if (node->kind == ND_CASE) {
+        vec_push(cases, node);
+    } else if (node->kind == ND_DEFAULT) {
+        if (*default_case) {
+            error("switch_cases() failure: defaultが複数あります");
+        }
+        *default_case = node;
+    }
+
+    find_cases(node->lhs, cases, default_case);
+    find_cases(node->rhs, cases, default_case);
+    find_cases(node->cond, cases, default_case);
+    find_cases(node->then, cases, default_case);
+    find_cases(node->els, cases, default_case);
+    find_cases(node->body, cases, default_case);
+    find_cases(node->init, cases, default_case);
+    find_cases(node->inc, cases, default_case);
+    for (int i = 0; node->stmts && i < node->stmts->len; i++) {
+        find_cases(node->stmts->body[i], cases, default_case);
+    }
+}
+
+static int compare_case(const void *p, const void *q) {
+    Node *a = *(Node **)p, *b = *(Node **)q;
+    return a->val < b->val ? -1 : a->val > b->val;
+}
+
+// switch文のcaseを値の小さい順に集める (defaultは*default_caseに入れる)
+Vector *switch_cases(Node *node, Node **default_case) {
+    Vector *cases = new_vec();
+    *default_case = NULL;
+    find_cases(node->body, cases, default_case);
+
+    qsort(cases->body, cases->len, sizeof(void *), compare_case);
+    for (int i = 1; i < cases->len; i++) {
+        if (((Node *)cases->body[i - 1])->val == ((Node *)cases->body[i])->val) {
+            error("switch_cases() failure: caseの値 %ld が重複しています", ((Node *)cases->body[i])->val);
+        }
+    }
+    return cases;
+}
+
+// 定数式なら値を求める
+bool eval_const(Node *node, long *val) {
+    while (node->kind == ND_SUGER && node->stmts->len == 1) {
+        node = node->stmts->body[0];
+    }
+
+    if (node->kind == ND_NUM) {
+        *val = node->val;
+        return true;
+    }
+
+    long l, r;
+    if (node->kind == ND_LOGICALNOT || node->kind == ND_NOT || node->kind == ND_CAST) {
+        if (!eval_const(node->lhs, &l)) return false;
+        if (node->kind == ND_LOGICALNOT) {
+            *val = !l;
+        } else if (node->kind == ND_NOT) {
+            *val = ~l;
+        } else if (node->type->size == 1) {
+            *val = (char)l;
+        } else if (node->type->size == 2) {
+            *val = (short)l;
+        } else if (node->type->size == 4) {
+            *val = (int)l;
+        } else {
+            *val = l;
+        }
+        return true;
+    }
+
+    if (node->lhs == NULL || node->rhs == NULL) return false;
+    if (!eval_const(node->lhs, &l) || !eval_const(node->rhs, &r)) return false;
+    switch (node->kind) {
+        case ND_ADD: *val = l + r; return true;
+        case ND_SUB: *val = l - r; return true;
+        case ND_MUL: *val = l * r; return true;
+        case ND_DIV: if (r == 0) return false; *val = l / r; return true;
+        case ND_MOD: if (r == 0) return false; *val = l % r; return true;
+        case ND_EQ: *val = l == r; return true;
+        case ND_NE: *val = l != r; return true;
+        case ND_LT: *val = l < r; return true;
+        case ND_LE: *val = l <= r; return true;
+        case ND_LSHIFT: *val = l << r; return true;
+        case ND_RSHIFT: *val = l >> r; return true;
+        case ND_AND: *val = l & r; return true;
+        case ND_OR: *val = l | r; return true;
+        case ND_XOR: *val = l ^ r; return true;
+        case ND_LOGICAL_AND: *val = l && r; return true;
+        case ND_LOGICAL_OR: *val = l || r; return true;
+        default: return false;
+    }
+}
+
+// 評価しても副作用がない式か
+bool is_pure(Node *node) {
+    if (node == NULL) return true;
+    switch (node->kind) {
+        case ND_ASSIGN:
+        case ND_ASSIGN_OP:
+        case ND_POST_INCDEC:
+        case ND_CALL:
+        case ND_RETURN:
+        case ND_BREAK:
+        case ND_CONTINUE:
+        case ND_IF:
+        case ND_FOR:
+        case ND_WHILE:
+        case ND_BLOCK:
+        case ND_SUGER:
+        case ND_STMT_EXPR:
+        case ND_INLINE:
+        case ND_SWITCH:
+        case ND_CASE:
+        case ND_DEFAULT:
+        case ND_ZERO_FILL:
+        case ND_TEMPLATE_COPY:
+            return false;
+        default:
+            break;
+    }
+    return is_pure(node->lhs) && is_pure(node->rhs) && is_pure(node->cond) && is_pure(node->then) &&
+           is_pure(node->els);
+}
+
+// 左辺値として同じ式か
+static bool same_lvalue(Node *a, Node *b) {
+    if (a == b) return true;
+    if (a == NULL || b == NULL) return false;
+    if (a->kind != b->kind || a->val != b->val || a->var != b->var) return false;
+    if (a->kind != ND_VAR && a->kind != ND_NUM && a->kind != ND_DEREF && a->kind != ND_STRUCT_MEMBER &&
+        a->kind != ND_ADD && a->kind != ND_SUB && a->kind != ND_MUL && a->kind != ND_CAST) {
+        return false;
+    }
+    return same_lvalue(a->lhs, b->lhs) && same_lvalue(a->rhs, b->rhs);
+}
+
+/*
+ * 複合代入 (ND_ASSIGN_OP ND_POST_INCDEC) の右辺 lhs op x の x を返す
+ *
+ * ポインターへの加算は x + lhs の順になっているので、交換できる演算は両側を見る。
+ * 最適化で右辺がこの形でなくなっていればNULLを返す。
+ */
+Node *assign_op_operand(Node *node) {
+    Node *op = node->rhs;
+    switch (op->kind) {
+        case ND_ADD:
+        case ND_MUL:
+        case ND_AND:
+        case ND_OR:
+        case ND_XOR:
+            if (same_lvalue(op->rhs, node->lhs)) return op->lhs;
+            // fallthrough
+        case ND_SUB:
+        case ND_DIV:
+        case ND_MOD:
+        case ND_LSHIFT:
+        case ND_RSHIFT:
+            if (same_lvalue(op->lhs, node->lhs)) return op->rhs;
+            return NULL;
+        default:
+            return NULL;
+    }
+}
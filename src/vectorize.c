@@ -0,0 +1,405 @@
+#include "kcc.h"
+
+/*
+ * ループのベクトル化 (-O1以上)
+ *
+ * 次の形のforループを、SSE2で16バイト (要素数 16 / 要素の大きさ) ずつ処理する
+ * ND_VECTOR_LOOPと、残りを1要素ずつ処理する元のループに分ける。
+ *
+ *   for (i = e; i < n; i++) {
+ *       a[i] = b[i] + c[i + 1] * 2;
+ *       ...
+ *   }
+ *
+ * 条件
+ *   - 条件式は i < n か i <= n で、nはループ中で値が変わらない式
+ *   - 増分は i++ (歩幅1)
+ *   - 本体は配列の要素への代入だけで、添字は i か i ± 定数
+ *   - 配列は配列型の変数 (ポインターは別名の可能性があるので扱わない)
+ *   - 要素は全て同じ大きさの整数型で、演算は + - & | ^ と定数による <<、
+ *     2バイトの要素なら * も使える (下位ビットだけで結果が決まる演算に限る)
+ *   - 書き込む配列は全て同じ添字で読み書きする (ループをまたぐ依存がない)
+ *
+ * ND_VECTOR_LOOP
+ *   cond:  i + (要素数 - 1) < n  (1回分の要素が残っているか)
+ *   stmts: 本体の代入式
+ *   inc:   i = i + 要素数
+ *   val:   要素の大きさ
+ *
+ * --vectorize-report を指定するとループごとに判断と理由を表示する。
+ */
+
+// 式の途中結果に使うxmmレジスタの数 (残りは不変式の複製に使う)
+#define VECTOR_TEMP_REGS 8
+#define VECTOR_INVARIANT_REGS 8
+
+static Function *fn;
+static int loop_count;
+
+// 検査中のループの情報
+static Var *ind_var;         // 誘導変数
+static int elem_size;        // 要素の大きさ (0なら未定)
+static Vector *stored;       // 書き込む配列
+static Vector *stored_offs;  // その添字のずれ
+static Vector *invariants;   // 不変式
+
+static Node *new_node(NodeKind kind, Type *ty) {
+    Node *node = memory_alloc(sizeof(Node));
+    node->kind = kind;
+    node->type = ty;
+    return node;
+}
+
+static Node *new_num(long val) {
+    Node *node = new_node(ND_NUM, new_type(TYPE_LONG));
+    node->val = val;
+    return node;
+}
+
+static Node *new_binary(NodeKind kind, Node *lhs, Node *rhs) {
+    Node *node = new_node(kind, NULL);
+    node->lhs = lhs;
+    node->rhs = rhs;
+    add_type(node);
+    return node;
+}
+
+static Node *unwrap(Node *node) {
+    while (node->kind == ND_SUGER && node->stmts->len == 1) {
+        node = node->stmts->body[0];
+    }
+    return node;
+}
+
+static void report(char *fmt, ...) {
+    if (!vectorize_report) return;
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "vectorize: %s: loop %d: %s\n", fn->name, loop_count, vformat(fmt, ap));
+    va_end(ap);
+}
+
+static bool is_ind_var(Node *node) {
+    node = unwrap(node);
+    return node->kind == ND_VAR && node->var == ind_var;
+}
+
+/*
+ * 誘導変数
+ */
+
+// i = i + 1 (i++, ++i, i += 1)
+static bool is_unit_increment(Node *node) {
+    node = unwrap(node);
+    if (!is_assignnode(node->kind) || !is_ind_var(node->lhs)) return false;
+
+    Node *rhs = unwrap(node->rhs);
+    if (rhs->kind != ND_ADD) return false;
+    Node *l = unwrap(rhs->lhs), *r = unwrap(rhs->rhs);
+    if (is_ind_var(l) && r->kind == ND_NUM) return r->val == 1;
+    if (is_ind_var(r) && l->kind == ND_NUM) return l->val == 1;
+    return false;
+}
+
+// ループ中で値が変わらず、何度評価しても副作用のない式か
+// (本体は配列の要素にしか書き込まないので、誘導変数以外のスカラー変数は変わらない)
+static bool is_invariant(Node *node) {
+    node = unwrap(node);
+    switch (node->kind) {
+        case ND_NUM:
+            return true;
+        case ND_VAR:
+            return node->var != ind_var && is_integertype(node->var->type->kind);
+        case ND_ADD:
+        case ND_SUB:
+        case ND_MUL:
+        case ND_AND:
+        case ND_OR:
+        case ND_XOR:
+        case ND_LSHIFT:
+        case ND_RSHIFT:
+            return is_invariant(node->lhs) && is_invariant(node->rhs);
+        case ND_NOT:
+        case ND_CAST:
+            return is_invariant(node->lhs);
+        default:
+            return false;
+    }
+}
+
+/*
+ * 配列の要素の参照
+ */
+
+// *(i * size + a) の形から配列と添字のずれを取り出す
+static char *analyze_access(Node *deref, Var **array, long *off) {
+    Type *ty = deref->type;
+    if (!is_integertype(ty->kind)) return "element is not an integer";
+
+    Node *addr = unwrap(deref->lhs);
+    if (addr->kind != ND_ADD) return "address is not array + index";
+    Node *base = unwrap(addr->rhs), *scaled = unwrap(addr->lhs);
+    if (base->kind != ND_VAR) return "array base is not a variable";
+    if (base->var->type->kind == TYPE_PTR) return "array base is a pointer (may alias)";
+    if (base->var->type->kind != TYPE_ARRAY) return "array base is not an array";
+
+    if (scaled->kind != ND_MUL || unwrap(scaled->rhs)->kind != ND_NUM || unwrap(scaled->rhs)->val != ty->size) {
+        return "index is not scaled by the element size";
+    }
+    Node *index = unwrap(scaled->lhs);
+    if (is_ind_var(index)) {
+        *off = 0;
+    } else if ((index->kind == ND_ADD || index->kind == ND_SUB) && is_ind_var(index->lhs) &&
+               unwrap(index->rhs)->kind == ND_NUM) {
+        *off = unwrap(index->rhs)->val;
+        if (index->kind == ND_SUB) *off = -*off;
+    } else {
+        return "stride is not 1";
+    }
+
+    if (elem_size == 0) {
+        elem_size = ty->size;
+    } else if (elem_size != ty->size) {
+        return "mixed element sizes";
+    }
+    *array = base->var;
+    return NULL;
+}
+
+// 書き込む配列を他の添字で読み書きしていないか
+static char *check_dependence(Var *array, long off) {
+    for (int i = 0; i < stored->len; i++) {
+        if (stored->body[i] == array && (long)stored_offs->body[i] != off) {
+            return format("loop-carried dependence on %s", array->name);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * 本体の式
+ */
+
+// 式の計算に使うxmmレジスタの数を求める (不変式は0)
+static char *check_expr(Node *node, int *regs) {
+    node = unwrap(node);
+    if (is_invariant(node)) {
+        vec_union1(invariants, node);
+        *regs = 0;
+        return NULL;
+    }
+
+    switch (node->kind) {
+        case ND_VAR:
+            if (node->var == ind_var) return "induction variable used as a value";
+            return format("%s is not loop-invariant", node->var->name);
+        case ND_DEREF: {
+            Var *array;
+            long off;
+            char *reason = analyze_access(node, &array, &off);
+            if (reason) return reason;
+            *regs = 1;
+            return NULL;
+        }
+        case ND_CAST:
+            // 要素より狭い型への変換は各要素の下位ビットだけでは計算できない
+            if (!is_integertype(node->type->kind) || node->type->size < elem_size) return "narrowing cast";
+            return check_expr(node->lhs, regs);
+        case ND_MUL:
+            // SSE2の要素ごとの掛け算は2バイトのpmullwだけ
+            if (elem_size != 2) return "multiply is not supported for this element size";
+            break;
+        case ND_LSHIFT:
+            if (elem_size == 1) return "shift is not supported for char elements";
+            if (unwrap(node->rhs)->kind != ND_NUM) return "shift count is not a constant";
+            return check_expr(node->lhs, regs);
+        case ND_ADD:
+        case ND_SUB:
+        case ND_AND:
+        case ND_OR:
+        case ND_XOR:
+            break;
+        default:
+            return "unsupported operation";
+    }
+
+    int l, r;
+    char *reason = check_expr(node->lhs, &l);
+    if (reason == NULL) reason = check_expr(node->rhs, &r);
+    if (reason) return reason;
+
+    // 左辺を結果のレジスタに、右辺をその次のレジスタに計算する
+    *regs = l > 1 ? l : 1;
+    if (r > 0 && r + 1 > *regs) *regs = r + 1;
+    return NULL;
+}
+
+// 配列の要素への代入文を集める
+static char *collect_stmts(Node *node, Vector *stmts) {
+    node = unwrap(node);
+    if (node->kind == ND_BLOCK || node->kind == ND_SUGER) {
+        for (int i = 0; i < node->stmts->len; i++) {
+            char *reason = collect_stmts(node->stmts->body[i], stmts);
+            if (reason) return reason;
+        }
+        return NULL;
+    }
+    if (node->kind == ND_NULL) return NULL;
+    // 文なので複合代入や後置の++も代入として扱える
+    if (!is_assignnode(node->kind) || unwrap(node->lhs)->kind != ND_DEREF) {
+        return "body has a statement other than an array store";
+    }
+    vec_push(stmts, node);
+    return NULL;
+}
+
+static char *check_body(Vector *stmts) {
+    if (stmts->len == 0) return "empty body";
+
+    // 先に書き込む配列を全て集める
+    for (int i = 0; i < stmts->len; i++) {
+        Node *assign = stmts->body[i];
+        Var *array;
+        long off;
+        char *reason = analyze_access(unwrap(assign->lhs), &array, &off);
+        if (reason) return reason;
+        reason = check_dependence(array, off);
+        if (reason) return reason;
+        vec_push(stored, array);
+        vec_push(stored_offs, (void *)off);
+    }
+
+    for (int i = 0; i < stmts->len; i++) {
+        Node *assign = stmts->body[i];
+        int regs;
+        char *reason = check_expr(assign->rhs, &regs);
+        if (reason) return reason;
+        if (regs > VECTOR_TEMP_REGS) return "expression is too complex";
+    }
+    if (invariants->len > VECTOR_INVARIANT_REGS) return "too many loop-invariant values";
+
+    // 読み込む配列の依存を調べる (書き込む配列と同じ添字でなければならない)
+    for (int i = 0; i < stmts->len; i++) {
+        Vector *work = new_vec();
+        vec_push(work, ((Node *)stmts->body[i])->rhs);
+        while (work->len > 0) {
+            Node *node = unwrap(vec_pop(work));
+            if (node->kind == ND_DEREF) {
+                Var *array;
+                long off;
+                analyze_access(node, &array, &off);
+                char *reason = check_dependence(array, off);
+                if (reason) return reason;
+                continue;
+            }
+            if (node->lhs) vec_push(work, node->lhs);
+            if (node->rhs) vec_push(work, node->rhs);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * ループの変換
+ */
+
+static char *check_loop(Node *node, Vector *stmts) {
+    if (node->kind != ND_FOR || node->cond == NULL || node->inc == NULL) return "not a counted for loop";
+
+    Node *cond = unwrap(node->cond);
+    if (cond->kind != ND_LT && cond->kind != ND_LE) return "condition is not i < n or i <= n";
+    Node *i = unwrap(cond->lhs);
+    if (i->kind != ND_VAR || !is_integertype(i->var->type->kind) || i->var->type->size < 4) {
+        return "no int or long induction variable";
+    }
+    ind_var = i->var;
+    if (!is_invariant(cond->rhs)) return "loop bound is not loop-invariant";
+    if (!is_unit_increment(node->inc)) return "stride is not 1";
+
+    char *reason = collect_stmts(node->body, stmts);
+    if (reason) return reason;
+    return check_body(stmts);
+}
+
+static Node *vectorize_loop(Node *node) {
+    loop_count++;
+    elem_size = 0;
+    ind_var = NULL;
+    stored = new_vec();
+    stored_offs = new_vec();
+    invariants = new_vec();
+
+    Vector *stmts = new_vec();
+    char *reason = check_loop(node, stmts);
+    if (reason) {
+        report("not vectorized (%s)", reason);
+        return node;
+    }
+
+    int lanes = 16 / elem_size;
+    report("vectorized (%d x %d bytes)", lanes, elem_size);
+
+    Node *cond = unwrap(node->cond);
+    Node *var = unwrap(cond->lhs);
+    Node *vloop = new_node(ND_VECTOR_LOOP, NULL);
+    vloop->cond = new_binary(cond->kind, new_binary(ND_ADD, var, new_num(lanes - 1)), cond->rhs);
+    vloop->inc = new_node(ND_ASSIGN, var->type);
+    vloop->inc->lhs = var;
+    vloop->inc->rhs = new_binary(ND_ADD, var, new_num(lanes));
+    vloop->stmts = stmts;
+    vloop->val = elem_size;
+
+    // 残りの要素は元のループで処理する (初期化式はベクトル化したループの前に評価する)
+    Node *suger = new_node(ND_SUGER, NULL);
+    suger->stmts = new_vec();
+    if (node->init) {
+        vec_push(suger->stmts, node->init);
+        node->init = NULL;
+    }
+    vec_push(suger->stmts, vloop);
+    vec_push(suger->stmts, node);
+    return suger;
+}
+
+// 内側のループだけが対象になる (本体にループを含むと代入文だけにならない)
+static void vectorize_node(Node **np) {
+    Node *node = *np;
+    if (node == NULL) return;
+
+    if (node->kind == ND_FOR || node->kind == ND_WHILE) {
+        // 外側のループから番号を振る
+        Node **body = &node->body;
+        *np = vectorize_loop(node);
+        vectorize_node(body);
+        return;
+    }
+
+    vectorize_node(&node->lhs);
+    vectorize_node(&node->rhs);
+    vectorize_node(&node->cond);
+    vectorize_node(&node->then);
+    vectorize_node(&node->els);
+    vectorize_node(&node->body);
+    vectorize_node(&node->init);
+    vectorize_node(&node->inc);
+    if (node->args) {
+        for (int i = 0; i < node->args->len; i++) {
+            vectorize_node((Node **)&node->args->body[i]);
+        }
+    }
+    if (node->stmts) {
+        for (int i = 0; i < node->stmts->len; i++) {
+            vectorize_node((Node **)&node->stmts->body[i]);
+        }
+    }
+}
+
+void vectorize_loops() {
+    for (int i = 0; i < funcs->len; i++) {
+        fn = funcs->body[i];
+        if (fn->is_prototype) continue;
+
+        loop_count = 0;
+        vectorize_node(&fn->body);
+    }
+}
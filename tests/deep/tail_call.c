@@ -0,0 +1,53 @@
+#include <stdio.h>
+
+/*
+ * 末尾呼び出しをjmpにしないとスタックが溢れる深さの再帰 (-O1以上でだけ実行する)
+ */
+
+int ASSERT(int expected, int actual, char *name) {
+    if (expected == actual)
+        return 0;
+
+    printf("name:<%s> failed!!\n", name);
+    printf("expected %d -> actual %d\n", expected, actual);
+    exit(1);
+}
+
+// 展開できる大きさの相互再帰 (片方をもう片方に展開すると末尾呼び出しがcallになる)
+int deep_odd(int n);
+int deep_even(int n) {
+    if (n == 0) return 1;
+    return deep_odd(n - 1);
+}
+int deep_odd(int n) {
+    if (n == 0) return 0;
+    return deep_even(n - 1);
+}
+
+// 引数の計算に展開した関数を含む3つの関数の相互再帰
+static int deep_dec(int n) {
+    return n - 1;
+}
+int deep_b(int n, int acc);
+int deep_c(int n, int acc);
+int deep_a(int n, int acc) {
+    if (n == 0) return acc;
+    return deep_b(deep_dec(n), acc + 1);
+}
+int deep_b(int n, int acc) {
+    if (n == 0) return acc;
+    return deep_c(deep_dec(n), acc + 2);
+}
+int deep_c(int n, int acc) {
+    if (n == 0) return acc % 1000;
+    return deep_a(deep_dec(n), (acc + 3) % 1000);
+}
+
+int main() {
+    ASSERT(0, deep_even(10000001), "deep_even(10000001)");
+    ASSERT(1, deep_odd(10000001), "deep_odd(10000001)");
+    ASSERT(3, deep_a(9000002, 0), "deep_a(9000002, 0)");
+
+    printf("ALL TEST OF deep/tail_call.c SUCCESS :)\n");
+    return 0;
+}
@@ -14,11 +14,17 @@ int main() {
     ASSERT(7, '\a', "\\a");
     ASSERT(92, '\\', "\\");
     ASSERT(39, '\'', "'");
+    ASSERT(11, '\v', "\\v");
 
     char buf[100] = {'\\', '"', '\\', '"', 0};
     char buf2[100] = "\"\"";
     ASSERT(strcmp(buf2, buf), 0, "\"\"");
 
+    // 途中に\0を含む文字列リテラルは後ろの部分も続けて置かれる
+    char *nul = "ab\0cd";
+    ASSERT(99, nul[3], "\"ab\\0cd\"[3]");
+    ASSERT(100, nul[4], "\"ab\\0cd\"[4]");
+
     printf("ALL TEST OF escape.c SUCCESS :)\n");
     return 0;
 }
\ No newline at end of file
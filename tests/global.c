@@ -166,6 +166,14 @@ int global_enum1(int index) {
         return C;
 }
 
+// staticのグローバル変数 (初期化式の中の型名でstaticが消えないこと)
+static int globalstatic_a = sizeof(int), globalstatic_b;
+static int globalstatic_arr[3] = {1, 2, 3};
+int globalstatic1() {
+    globalstatic_b = globalstatic_a * 2;
+    return globalstatic_a + globalstatic_b + globalstatic_arr[2];
+}
+
 int main() {
     ASSERT(3, globaltest1(), "globaltest1");
     ASSERT(2, globaltest2(), "globaltest2");
@@ -187,6 +195,8 @@ int main() {
     ASSERT(2, global_enum1(1), "global_enum1(1)");
     ASSERT(3, global_enum1(2), "global_enum1(2)");
 
+    ASSERT(15, globalstatic1(), "globalstatic1");
+
     printf("ALL TEST OF global.c SUCCESS :)\n");
 
     return 0;
@@ -94,6 +94,42 @@ int init_array12() {
     return a[0][0] + a[1][1] + a[2][2];
 }
 
+// スタックに0でない値を残しておく
+int dirty_stack() {
+    char a[8192];
+    for (int i = 0; i < 8192; i++) a[i] = 85;
+    return a[100];
+}
+
+int init_array13() {
+    int a[1000] = {1, 2, 3};
+    int sum = 0;
+    for (int i = 0; i < 1000; i++) sum = sum + a[i];
+    return sum + a[999];
+}
+
+int init_array14(int x) {
+    long a[10] = {1, x, -3, x * 2, 0, 4294967296};
+    return a[0] + a[1] + a[2] + a[3] + a[4] + a[9] + a[5] / 65536;
+}
+
+int init_array15() {
+    char buf[4096] = "hello";
+    int n = 0;
+    for (int i = 0; i < 4096; i++) {
+        if (buf[i] == 0) n++;
+    }
+    return n + buf[4];
+}
+
+int init_array16() {
+    short a[4][5] = {{1, 2}, {3}, {0}, {-1, 0, 0, 0, 7}};
+    int sum = 0;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 5; j++) sum = sum + a[i][j] * (i * 5 + j + 1);
+    return sum;
+}
+
 int test1 = 10;
 int test2_1 = 1 + 2 - (3 * 4) / 5, test2_2 = 1;
 int *test3_1 = 1, test3_2 = 2;
@@ -114,6 +150,13 @@ char *test14 = &test4;
 int test15 = (1 && 0) && !(0 && 0);
 int test16 = (1 < 2) && (1 <= 2);
 int test17 = (1 == 2) && (1 != 2);
+int test18[1000] = {1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3};
+int test19[4][3] = {{1, 2, 3}, {4}};
+int test20[64] = {0};
+char test21[32] = "hello, kcc";
+char *test22[3] = {"ab", 0, "cd"};
+long test23[2] = {-2, 1 - 1};
+short test24[5] = {-1, 0, 0, 0, 7};
 
 int main() {
     ASSERT(4, init_array1(), "init_array1");
@@ -128,6 +171,14 @@ int main() {
     ASSERT(195, init_array10(), "init_array10");
     ASSERT(330, init_array11(), "init_array11");
     ASSERT(330, init_array12(), "init_array12");
+    ASSERT(85, dirty_stack(), "dirty_stack");
+    ASSERT(6, init_array13(), "init_array13");
+    ASSERT(85, dirty_stack(), "dirty_stack");
+    ASSERT(65549, init_array14(5), "init_array14");
+    ASSERT(85, dirty_stack(), "dirty_stack");
+    ASSERT(4202, init_array15(), "init_array15");
+    ASSERT(85, dirty_stack(), "dirty_stack");
+    ASSERT(147, init_array16(), "init_array16");
 
     ASSERT(10, test1, "test1");
     ASSERT(1, test2_1, "test2_1");
@@ -148,6 +199,16 @@ int main() {
     ASSERT(0, test15, "test15");
     ASSERT(1, test16, "test16");
     ASSERT(0, test17, "test17");
+    ASSERT(6, test18[0] + test18[1] + test18[13] + test18[999], "test18");
+    ASSERT(7, test19[0][2] + test19[1][0] + test19[1][2] + test19[3][2] + sizeof(test19) / 4 - 12, "test19");
+    ASSERT(0, test20[0] + test20[63], "test20");
+    ASSERT(107, test21[7], "test21[7]");
+    ASSERT(0, test21[10], "test21[10]");
+    ASSERT(0, test21[31], "test21[31]");
+    ASSERT(197, test22[0][1] + test22[2][0], "test22");
+    ASSERT(1, test22[1] == 0, "test22[1]");
+    ASSERT(-2, test23[0] + test23[1], "test23");
+    ASSERT(6, test24[0] + test24[3] + test24[4], "test24");
 
     printf("ALL TEST OF init.c SUCCESS :)\n");
     return 0;
@@ -102,6 +102,21 @@ int break_for_loop1() {
     return i + j;
 }
 
+int break_for_loop2() {
+    int n = 0;
+    int i = 0;
+    while (i < 10) {
+        i++;
+        for (int j = 0; j < 2; j++) {
+        }
+        for (int k = 0; k < 3; k++) {
+        }
+        n++;
+        if (i == 4) break;
+    }
+    return n * 10 + i;
+}
+
 int continue_for1() {
     int res = 0;
     for (int i = 0; i < 10; i++) {
@@ -249,6 +264,115 @@ int complex_loop1() {
     return res;
 }
 
+int add1(int a) {
+    return a + 1;
+}
+
+// 割り当て可能なレジスタより多くの変数が関数呼び出しを跨いで生きる
+int many_vars1() {
+    int a = 1, b = 2, c = 3, d = 4, e = 5, f = 6, g = 7, h = 8, k = 9;
+    char ch = 0;
+    for (int i = 0; i < 10; i++) {
+        a = add1(a);
+        b = b + a;
+        c = c + b;
+        d = add1(d) + c;
+        e = e + d;
+        f = f + e;
+        g = add1(g);
+        h = h + g;
+        k = k + h;
+        ch = ch + 100;
+    }
+    return a + b + c + d + e + f + g + h + k + ch;
+}
+
+int cond_branch1() {
+    int res = 0;
+    for (int i = -3; i <= 3; i++) {
+        if (i < 0) res += 1;
+        if (i >= 0) res += 10;
+        if (!(i != 2)) res += 100;
+        if (!i) res += 1000;
+        res += i > 1 ? 10000 : 0;
+    }
+
+    int j = 10;
+    while (!(j <= 0)) {
+        j -= 3;
+    }
+    return res + j * 100000;
+}
+
+int licm_count;
+int licm_limit = 7;
+int licm_escaped;
+int licm_grid[4][5];
+
+int licm_bump() {
+    licm_count++;
+    return licm_count;
+}
+
+int licm1() {
+    // グローバル変数の読み書き (ループ後に書き戻す)
+    licm_count = 0;
+    for (int i = 0; i < 10; i++) {
+        if (i == licm_limit) break;
+        licm_count += i;
+    }
+    return licm_count;
+}
+
+int licm2() {
+    // 呼び出しを含むループでは置き換えない
+    licm_count = 0;
+    int s = 0;
+    while (licm_count < 5) {
+        s += licm_bump() * licm_limit;
+    }
+    return s + licm_count;
+}
+
+int licm3() {
+    // アドレスを取られたグローバル変数はポインタ経由で書き換わる
+    int *p = &licm_escaped;
+    licm_escaped = 1;
+    int s = 0;
+    for (int i = 0; i < 4; i++) {
+        s += licm_escaped * 10;
+        *p = *p + 1;
+    }
+    return s;
+}
+
+int licm4() {
+    // 内側のループで行の先頭アドレスが変わらない
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 5; j++) {
+            licm_grid[i][j] = i * 10 + j;
+        }
+    }
+    int s = 0;
+    int k = 2;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 5; j++) {
+            s += licm_grid[i][j] * (k + 1);
+        }
+        k = k + 1;
+    }
+    return s;
+}
+
+int licm5(int n) {
+    // returnで抜けるループでも正しい値を読む
+    licm_count = n;
+    for (int i = 0; i < 100; i++) {
+        if (licm_count + i > 20) return licm_count * 100 + i;
+    }
+    return -1;
+}
+
 int main() {
     ASSERT(66, for1(), "for1");
 
@@ -257,6 +381,7 @@ int main() {
     ASSERT(10, break_while1(), "break_while1");
     ASSERT(15, break_while2(), "break_while2");
     ASSERT(8, break_for_loop1(), "break_for_loop1");
+    ASSERT(44, break_for_loop2(), "break_for_loop2");
 
     ASSERT(25, continue_for1(), "continue_for1");
     ASSERT(3, continue_for2(), "continue_for2");
@@ -265,6 +390,14 @@ int main() {
     ASSERT(4, continue_while2(), "continue_while2");
 
     ASSERT(9, complex_loop1(), "complex_loop1");
+    ASSERT(15300, many_vars1(), "many_vars1");
+    ASSERT(-178857, cond_branch1(), "cond_branch1");
+
+    ASSERT(21, licm1(), "licm1");
+    ASSERT(110, licm2(), "licm2");
+    ASSERT(100, licm3(), "licm3");
+    ASSERT(1780, licm4(), "licm4");
+    ASSERT(1506, licm5(15), "licm5");
 
     printf("ALL TEST OF test.c SUCCESS :)\n");
     return 0;
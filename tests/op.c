@@ -207,6 +207,102 @@ int cumma3() {
 typedef struct FILE FILE;
 extern FILE *stderr, stdout;
 
+int count_up(int *cnt, int ret) {
+    *cnt = *cnt + 1;
+    return ret;
+}
+
+int short_circuit1() {
+    int cnt = 0;
+    int a = 0 && count_up(&cnt, 1);
+    int b = 1 || count_up(&cnt, 1);
+    int c = count_up(&cnt, 1) && count_up(&cnt, 0) && count_up(&cnt, 1);
+    int d = count_up(&cnt, 0) || count_up(&cnt, 0) || count_up(&cnt, 7);
+    return cnt * 100 + a * 1000 + b * 10 + c * 2 + d;
+}
+
+int short_circuit2() {
+    int *p = 0;
+    int x = 5;
+    int res = 0;
+    if (p && *p == 5) res += 1;
+    p = &x;
+    if (p && *p == 5 && x != 0) res += 10;
+    if (!p || *p != 5) res += 100;
+    while (p && *p > 0) *p = *p - 2;
+    return res + x * 1000;
+}
+
+int const_div1(int n) {
+    return n / 2 + n / 3 * 10 + n / -8 * 100 + n / 10 * 1000;
+}
+
+int const_mod1(int n) {
+    return n % 2 + n % 7 * 10 + n % 16 * 100 + n % -10 * 1000;
+}
+
+int const_mul1(int n) {
+    return n * 3 + n * 40 + n * -9 + 7 * n;
+}
+
+// 値を使わない位置の代入、++ --、三項演算子と、値を使う最後の文
+int stmt_expr1(int n) {
+    int s = 0;
+    int t = ({
+        int i;
+        for (i = 0; i < n; i++) {
+            if (i % 2) s += i;
+            else s -= 1;
+            i == 3 ? s++ : s--;
+        }
+        s * 2;
+    });
+    return t * 10 + ({ s = 1; s++; s; });
+}
+
+// 右に深い式は右辺から計算する (引き算や比較は左右を保つ)
+int su_order1(int *v) {
+    int x = v[0] - (v[1] * (v[2] - (v[3] / (v[4] - 1))));
+    int y = (v[0] < (v[1] + (v[2] * (v[3] - v[4])))) + ((v[0] - v[1]) - (v[2] - (v[3] - (v[4] << 2)))) * 10;
+    if (v[4] - v[0] < v[1] * (v[2] + v[3] * (v[0] - v[4]))) y += 10000;
+    return x * 100 + y;
+}
+
+int cache_fib(int n) {
+    return n < 2 ? n : cache_fib(n - 1) + cache_fib(n - 2);
+}
+
+// 式の途中の関数呼び出しや条件式の前後でも積んだ値が保たれる
+int cache_stack1(int *v) {
+    int s = 0;
+    for (int i = 0; i < 5; i++) {
+        s += ((v[i] + 1) * (v[i] - 2 + (v[i] * 3 - (v[i] ^ 5)))) - cache_fib(v[i] % 6 + i) * (i > 2 ? v[i] : -v[i]);
+    }
+    return s;
+}
+
+// 即値を積んだまま関数を呼び出したり分岐したりしても値が保たれる
+long cache_stack2(int *v) {
+    long s = 0;
+    for (int i = 0; i < 4; i++) {
+        s += 5000000000 - (v[i] + (7 - (cache_fib(v[i + 1] % 8) * (i > 1 ? v[i] - 3 : 9 - v[i])))) % 100000;
+        s -= 3000000000 / (1 + (v[i] > 5 && v[i + 1] < 10));
+    }
+    return s % 1000000007;
+}
+
+// intどうしの割り算は32bitで、longが混じる割り算は64bitで計算する
+int div32_1(int *v) {
+    int s = 0;
+    long big = 12884901888;
+    char c = -9;
+    for (int i = 0; i < 4; i++) {
+        s = s * 7 + v[i] / v[i + 1] + v[i] % v[i + 1] * 3 + c / v[i + 1] + c % v[i + 1];
+        s = s + (big + v[i]) % v[i + 1] + (int)((big * v[i]) / v[i + 1] % 1000);
+    }
+    return s;
+}
+
 int main() {
     ASSERT(0, logical_not1(), "logical_not1");
     ASSERT(1, logical_not2(), "logical_not2");
@@ -226,6 +322,8 @@ int main() {
     ASSERT(2, logical_or5(), "logical_or5");
 
     ASSERT(0, logical_expr1(), "logical_expr1");
+    ASSERT(511, short_circuit1(), "short_circuit1");
+    ASSERT(-990, short_circuit2(), "short_circuit2");
 
     ASSERT(10, termary1(1), "termary1(1)");
     ASSERT(2, termary1(0), "termary1(0)");
@@ -239,6 +337,11 @@ int main() {
     ASSERT(11, and_or_xor4(), "and_or_xor4");
     ASSERT(1, and_or_xor5(), "and_or_xor5");
 
+    ASSERT(-6388, const_div1(-77), "const_div1(-77)");
+    ASSERT(6388, const_div1(77), "const_div1(77)");
+    ASSERT(-8301, const_mod1(-77), "const_mod1(-77)");
+    ASSERT(-2255, const_mul1(-55), "const_mul1(-55)");
+
     ASSERT(-2, not1(), "not1");
     ASSERT(10, not2(), "not2");
 
@@ -259,6 +362,14 @@ int main() {
     ASSERT(0, ({ 0; }), "({0;})");
     ASSERT(10, ({int a;a = 10;a; }), "({int a;a = 10;a; })");
     ASSERT(5, ({ 3; }) * ({ 2; }) - ({ 1; }), "({3;}) * ({2;}) - ({1})");
+    ASSERT(42, stmt_expr1(6), "stmt_expr1");
+
+    int su_v[5] = {7, 3, 9, 20, 5};
+    ASSERT(9451, su_order1(su_v), "su_order1");
+    ASSERT(1608, cache_stack1(su_v), "cache_stack1");
+    ASSERT(999999976, cache_stack2(su_v), "cache_stack2");
+    int div_v[5] = {-7, 3, 100, -6, 5};
+    ASSERT(-25437, div32_1(div_v), "div32_1");
 
     ASSERT(1, stderr != 0, "stderr != NULL");
     ASSERT(1, stdout != 0, "stdout != NULL");
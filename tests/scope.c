@@ -126,6 +126,45 @@ int local_scope8() {
     res += p1.r;
 }
 
+int local_scope9() {
+    char c;
+    long l;
+    char d;
+    int i;
+    short s;
+    return ((long)&l % 8 == 0) + ((long)&i % 4 == 0) * 2 + ((long)&s % 2 == 0) * 4;
+}
+
+int local_scope10() {
+    char *p;
+    char *q;
+    {
+        char a[64];
+        p = a;
+    }
+    {
+        char b[64];
+        q = b;
+    }
+    return p == q;
+}
+
+int local_scope11() {
+    int x = 1;
+    {
+        int a[4];
+        for (int i = 0; i < 4; i++) a[i] = i;
+        x += a[3];
+    }
+    int y = 10;
+    {
+        int b[4];
+        for (int i = 0; i < 4; i++) b[i] = 100;
+        y += b[0];
+    }
+    return x + y;
+}
+
 int main() {
     ASSERT(1, local_scope1(), "local_scope1");
     ASSERT(1, local_scope2(), "local_scope2");
@@ -135,6 +174,9 @@ int main() {
     ASSERT(55, local_scope6(), "local_scope6");
     ASSERT(90, local_scope7(), "local_scope7");
     ASSERT(70, local_scope8(), "local_scope8");
+    ASSERT(7, local_scope9(), "local_scope9");
+    ASSERT(1, local_scope10(), "local_scope10");
+    ASSERT(114, local_scope11(), "local_scope11");
 
     printf("ALL TEST OF scope.c SUCCESS :)\n");
     return 0;
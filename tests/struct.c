@@ -300,6 +300,37 @@ int struct_assign4() {
     return c.m1.m1[5] + c.m2[5];
 }
 
+int struct_assign5() {
+    struct A {
+        char m[23];
+    };
+    struct B {
+        struct A m1;
+        char m2;
+    } a, b;
+    for (int i = 0; i < 23; i++) a.m1.m[i] = i;
+    a.m2 = 100;
+    b.m2 = 50;
+    b.m1 = a.m1;
+    int sum = 0;
+    for (int i = 0; i < 23; i++) sum += b.m1.m[i];
+    // コピーが構造体の末尾を越えて書き込まないこと
+    return sum + b.m2;
+}
+
+int struct_assign6() {
+    struct A {
+        int m[60];
+    } a, b, *p = malloc(sizeof(struct A));
+    for (int i = 0; i < 60; i++) a.m[i] = i;
+    b = a;
+    *p = b;
+    a.m[59] = 0;
+    int sum = 0;
+    for (int i = 0; i < 60; i++) sum += p->m[i];
+    return sum + b.m[59];
+}
+
 int main() {
     ASSERT(11, struct1(), "struct1");
     ASSERT(2, struct2(), "struct2");
@@ -322,6 +353,8 @@ int main() {
     ASSERT(1, struct_assign2(), "struct_assign2");
     ASSERT(15, struct_assign3(), "struct_assign3");
     ASSERT(15, struct_assign4(), "struct_assign4");
+    ASSERT(303, struct_assign5(), "struct_assign5");
+    ASSERT(1829, struct_assign6(), "struct_assign6");
 
     printf("ALL TEST OF struct.c SUCCESS :)\n");
     return 0;
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <string.h>
+
+int ASSERT(int expected, int actual, char *name) {
+    if (expected == actual)
+        return 0;
+
+    printf("name:<%s> failed!!\n", name);
+    printf("expected %d -> actual %d\n", expected, actual);
+    exit(1);
+}
+
+// 比較の木になる
+int switch1(int x) {
+    switch (x) {
+        case 1:
+            return 10;
+        case 2:
+            return 20;
+    }
+    return 0;
+}
+
+// ジャンプテーブルになる
+int switch2(int x) {
+    int res = 0;
+    switch (x) {
+        case 0:
+            res = 5;
+            break;
+        case 1:
+            res = 7;
+            break;
+        case 2:
+            res = 11;
+            break;
+        case 3:
+            res = 13;
+            break;
+        case 5:
+            res = 17;
+            break;
+        case 6:
+            res = 19;
+            break;
+        default:
+            res = -1;
+            break;
+    }
+    return res;
+}
+
+// 値が離れているので比較の木になる
+int switch3(long x) {
+    switch (x) {
+        case -100000:
+            return 1;
+        case -5:
+            return 2;
+        case 0:
+            return 3;
+        case 42:
+            return 4;
+        case 1000:
+            return 5;
+        case 65536:
+            return 6;
+        case 1000000:
+            return 7;
+        case 4294967296:
+            return 8;
+    }
+    return 9;
+}
+
+// 飛び先が少ないのでビットテストになる
+int is_space(int c) {
+    switch (c) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\v':
+        case '\f':
+        case '\r':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int switch4() {
+    char *s = "a b\tc\nd  e";
+    int n = 0;
+    for (int i = 0; s[i]; i++) {
+        n = n + is_space(s[i]);
+    }
+    return n;
+}
+
+// フォールスルーと途中のdefault
+int switch5(int x) {
+    int res = 0;
+    switch (x) {
+        case 1:
+            res = res + 1;
+        default:
+            res = res + 10;
+        case 2:
+            res = res + 100;
+            break;
+        case 3:
+            res = res + 1000;
+    }
+    return res;
+}
+
+// ループの中のswitchのbreakとcontinue
+int switch6() {
+    int sum = 0;
+    for (int i = 0; i < 10; i++) {
+        switch (i % 3) {
+            case 0:
+                continue;
+            case 1:
+                sum = sum + i;
+                break;
+            default:
+                sum = sum + 100;
+        }
+        sum = sum + 1000;
+    }
+    return sum;
+}
+
+// 入れ子のswitch
+int switch7(int x, int y) {
+    switch (x) {
+        case 0:
+            switch (y) {
+                case 0:
+                    return 1;
+                case 1:
+                    break;
+                default:
+                    return 2;
+            }
+            return 3;
+        case 1:
+            return 4;
+    }
+    return 5;
+}
+
+// 文の途中にあるcase
+int switch8(int x) {
+    int res = 0;
+    switch (x) {
+        case 0:
+            res = 1;
+            if (res) {
+                case 1:
+                    res = res + 10;
+            }
+            break;
+        case 2: {
+            int y = 3;
+            res = y * 2;
+            break;
+        }
+    }
+    return res;
+}
+
+// caseの値に定数式を使う
+int switch9(char c) {
+    switch (c) {
+        case 'a' + 1:
+            return 1;
+        case 2 * 3:
+            return 2;
+        case -1:
+            return 3;
+    }
+    return 4;
+}
+
+int main() {
+    ASSERT(10, switch1(1), "switch1(1)");
+    ASSERT(20, switch1(2), "switch1(2)");
+    ASSERT(0, switch1(3), "switch1(3)");
+
+    ASSERT(5, switch2(0), "switch2(0)");
+    ASSERT(13, switch2(3), "switch2(3)");
+    ASSERT(-1, switch2(4), "switch2(4)");
+    ASSERT(19, switch2(6), "switch2(6)");
+    ASSERT(-1, switch2(7), "switch2(7)");
+    ASSERT(-1, switch2(-1), "switch2(-1)");
+
+    ASSERT(1, switch3(-100000), "switch3(-100000)");
+    ASSERT(2, switch3(-5), "switch3(-5)");
+    ASSERT(3, switch3(0), "switch3(0)");
+    ASSERT(4, switch3(42), "switch3(42)");
+    ASSERT(6, switch3(65536), "switch3(65536)");
+    ASSERT(7, switch3(1000000), "switch3(1000000)");
+    ASSERT(8, switch3(4294967296), "switch3(4294967296)");
+    ASSERT(9, switch3(1), "switch3(1)");
+    ASSERT(9, switch3(4294967295), "switch3(4294967295)");
+
+    ASSERT(5, switch4(), "switch4");
+    ASSERT(0, is_space('a'), "is_space('a')");
+    ASSERT(0, is_space(14), "is_space(14)");
+    ASSERT(0, is_space(-1), "is_space(-1)");
+
+    ASSERT(111, switch5(1), "switch5(1)");
+    ASSERT(100, switch5(2), "switch5(2)");
+    ASSERT(1000, switch5(3), "switch5(3)");
+    ASSERT(110, switch5(4), "switch5(4)");
+
+    ASSERT(6312, switch6(), "switch6");
+
+    ASSERT(1, switch7(0, 0), "switch7(0, 0)");
+    ASSERT(3, switch7(0, 1), "switch7(0, 1)");
+    ASSERT(2, switch7(0, 2), "switch7(0, 2)");
+    ASSERT(4, switch7(1, 0), "switch7(1, 0)");
+    ASSERT(5, switch7(2, 0), "switch7(2, 0)");
+
+    ASSERT(11, switch8(0), "switch8(0)");
+    ASSERT(10, switch8(1), "switch8(1)");
+    ASSERT(6, switch8(2), "switch8(2)");
+    ASSERT(0, switch8(3), "switch8(3)");
+
+    ASSERT(1, switch9('b'), "switch9('b')");
+    ASSERT(2, switch9(6), "switch9(6)");
+    ASSERT(3, switch9(-1), "switch9(-1)");
+    ASSERT(4, switch9(0), "switch9(0)");
+
+    printf("ALL TEST OF switch.c SUCCESS :)\n");
+    return 0;
+}
@@ -3,6 +3,7 @@
 COMPILER="kcc"
 SUCCESS=0
 FAILURE=1
+OPTIONS=("-O0" "-O1" "-O1 -fomit-frame-pointer")
 
 debug() {
     FILENAME=`basename "$0"`
@@ -16,21 +17,51 @@ fi
 
 for i in tests/*.c
 do
-    debug "kcc start compileing $i"
-    ./kcc $i > tmp.s
-    ERRCHK=$?
-    if [ $ERRCHK -ne $SUCCESS ]; then
-        debug "kcc failed to compile"
-        exit $FAILURE
-    fi
-
-    cc -static -o tmp tmp.s
-    ./tmp
-
-    ERRCHK=$?
-    if [ $ERRCHK -ne $SUCCESS ]; then
-        debug "$i failed to exec"
-        exit $FAILURE
-    fi
-
-done
\ No newline at end of file
+    for opt in "${OPTIONS[@]}"
+    do
+        debug "kcc start compileing $i ($opt)"
+        ./kcc $opt $i > tmp.s
+        ERRCHK=$?
+        if [ $ERRCHK -ne $SUCCESS ]; then
+            debug "kcc failed to compile"
+            exit $FAILURE
+        fi
+
+        cc -static -o tmp tmp.s
+        ./tmp
+
+        ERRCHK=$?
+        if [ $ERRCHK -ne $SUCCESS ]; then
+            debug "$i failed to exec ($opt)"
+            exit $FAILURE
+        fi
+    done
+done
+
+# 末尾呼び出しをjmpにしないとスタックが溢れるテストは-O1以上でだけ実行する
+for i in tests/deep/*.c
+do
+    for opt in "${OPTIONS[@]}"
+    do
+        if [ "$opt" = "-O0" ]; then
+            continue
+        fi
+
+        debug "kcc start compileing $i ($opt)"
+        ./kcc $opt $i > tmp.s
+        ERRCHK=$?
+        if [ $ERRCHK -ne $SUCCESS ]; then
+            debug "kcc failed to compile"
+            exit $FAILURE
+        fi
+
+        cc -static -o tmp tmp.s
+        ./tmp
+
+        ERRCHK=$?
+        if [ $ERRCHK -ne $SUCCESS ]; then
+            debug "$i failed to exec ($opt)"
+            exit $FAILURE
+        fi
+    done
+done
@@ -389,6 +389,38 @@ int null_statement1() {
     return 1;
 }
 
+// 不要コード
+int dead_code1_count;
+int dead_code1_inc() { return ++dead_code1_count; }
+int dead_code1() {
+    int s = 0;
+    if (0) {
+        s = s + 100;
+    }
+    if (2 * 3 == 6) s = s + 1;
+    else s = s + 1000;
+    while (0) s = s + 10000;
+    for (int i = dead_code1_inc(); 1 < 0; i++) s = s + 10000;  // 初期化式は実行する
+    int dead = dead_code1_inc();  // 読まれない変数への代入でも右辺は評価する
+    s;
+    s + 1;
+    for (int i = 0; i < 5; i++) {
+        s = s + i;
+        continue;
+        s = s + 100;
+    }
+    return s * 10 + dead_code1_count + (1 ? 0 : dead_code1_inc());
+    s = 0;
+}
+char dead_code2_char() {
+    char c;
+    c = 300;  // 値を使う代入は変換を残す
+    int x;
+    int y = (x = 300);
+    return c + (1 - 1 ? x : y);
+}
+int dead_code2() { return dead_code2_char(); }
+
 // func call (関数の実態はリンクする)
 int func_call1() { return ret(); }
 int func_call2() { return ret(); }
@@ -402,6 +434,17 @@ int func_call5() { return add(1, 2); }
 int func_call6() { return add6(1, 2, 3, 4, 5, 6); }
 int func_call7() { return add6(1, 2, add6(3, 4, 5, 6, 7, 8), 9, 10, 11); }
 int func_call8() { return add6(1, 2, add6(3, add6(4, 5, 6, 7, 8, 9), 10, 11, 12, 13), 14, 15, 16); }
+int func_call9() {
+    int x = 3;
+    int a[2];
+    a[1] = 4;
+    int s = 0;
+    for (int i = 0; i < 10; i++) {
+        // 引数の評価途中でbreakしてもスタックが崩れないこと
+        s = s + add(i, ({ if (i == 5) break; x; }));
+    }
+    return add6(x, a[1] * 2, add(x, 1), &x != 0, x - 1, s);
+}
 
 // func define
 int func_define1_test() { return 2; }
@@ -443,6 +486,91 @@ int func_define8_fib(int n) {
 }
 int func_define8() { return func_define8_fib(10); }
 
+// インライン展開
+static int inline1_find(int *a, int n, int x) {
+    for (int i = 0; i < n; i++) {
+        if (a[i] == x) return i;  // ループの途中からのreturn
+    }
+    return -1;
+}
+int inline1() {
+    int a[5];
+    for (int i = 0; i < 5; i++) a[i] = i * 3;
+    return inline1_find(a, 5, 9) * 10 + inline1_find(a, 5, 7);
+}
+char inline2_char(int x) { return x; }
+void inline2_add(int *p, int x) {
+    if (x < 0) return;
+    *p = *p + x;
+}
+int inline2() {
+    int s = 0;
+    inline2_add(&s, inline2_char(300));  // charへの変換
+    inline2_add(&s, -5);
+    inline2_add(&s, inline2_char(-1) + 2);
+    return s;
+}
+// 一度しか呼ばれないstatic関数は大きくても展開する
+static int inline3_once(int n) {
+    int s = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < i; j++) {
+            if ((i + j) % 3 == 0) s = s + i * j;
+            else s = s - j;
+        }
+    }
+    return s + func_define8_fib(n);
+}
+int inline3() { return inline3_once(8); }
+
+// 末尾呼び出し
+long tail_call1_sum(long n, long acc) {
+    if (n == 0) return acc;
+    return tail_call1_sum(n - 1, acc + n);
+}
+int tail_call1() { return tail_call1_sum(10000, 0) % 1000; }
+int tail_call2_odd(int n);
+int tail_call2_even(int n) {
+    if (n == 0) return 1;
+    return tail_call2_odd(n - 1);
+}
+int tail_call2_odd(int n) {
+    if (n == 0) return 0;
+    return tail_call2_even(n - 1);
+}
+int tail_call2() { return tail_call2_even(1000) * 10 + tail_call2_odd(777); }
+int tail_call3_gcd(int a, int b) {
+    int s = 0;
+    for (int i = 0; i < 3; i++) s = s + a;  // 退避したレジスタを戻してから飛ぶこと
+    if (b == 0) return a + s - s;
+    return tail_call3_gcd(b, a % b);
+}
+int tail_call3_local(int *p, int n) {
+    int x = *p + n;
+    if (n == 0) return x;
+    return tail_call3_local(&x, n - 1);  // ローカル変数のアドレスを渡すので末尾呼び出しにしない
+}
+// 展開されない大きさの関数どうしの末尾呼び出し (jmpで飛ぶ)
+int tail_call4_b(int n, int acc);
+int tail_call4_a(int n, int acc) {
+    if (n <= 0) return acc;
+    int x = n * 3 + acc % 7;
+    if (x % 2 == 0) x = x / 2;
+    else x = x * 3 + 1;
+    acc = acc + x % 11 + (n & 3) + (acc >> 2) % 5;
+    return tail_call4_b(n - 1, acc % 1000);
+}
+int tail_call4_b(int n, int acc) {
+    if (n <= 0) return acc + 1;
+    int y = n * 5 - acc % 3;
+    if (y % 3 == 0) y = y / 3;
+    else y = y + 7;
+    acc = acc + y % 13 - (n | 1) % 4 + (acc << 1) % 9;
+    return tail_call4_a(n - 1, acc % 1000);
+}
+int tail_call4() { return tail_call4_a(20000, 1); }
+int tail_call3() { int v = 1; return tail_call3_gcd(1071, 462) + tail_call3_local(&v, 10); }
+
 // ポインター
 int pointer1() {
     int x;
@@ -586,6 +714,40 @@ int array5() {
     }
     return a[2][1];
 }
+// 添字と構造体のメンバーをアドレッシングモードで読み書きする
+short array6_g[8];
+int array6(int n) {
+    long l[5];
+    char c[6];
+    int a[4] = {1, 2, 3, 4};
+    int *p;
+    int i;
+    for (i = 0; i < 5; i++) {
+        l[i] = i * 100;
+        array6_g[i + 1] = i - 2;
+    }
+    for (i = 0; i < 6; i++) c[i] = 'a' + i;
+    p = a + 2;
+    p[-1] += 10;
+    a[n]++;
+    int old = a[n - 1]++;
+    return l[n + 1] + array6_g[n + 1] + c[n + 2] + p[-1] + a[3] + old * 1000 + a[2] * 10000;
+}
+struct array7_s {
+    int x;
+    int y[2];
+};
+int array7() {
+    struct array7_s s[3];
+    int i;
+    for (i = 0; i < 3; i++) {
+        s[i].x = i;
+        s[i].y[1] = i * 2;
+    }
+    struct array7_s *q = &s[1];
+    q->y[0] = 7;
+    return s[2].x + s[2].y[1] * 10 + q->y[0] * 100 + (&s[i - 1])->x * 1000;
+}
 
 // MOD
 int mod1_gcd(int a, int b) {
@@ -621,6 +783,12 @@ int string_literal1() {
     printf("%s\n", a);
     return 0;
 }
+int string_literal2() {
+    char *a = "kcc";
+    char *b = "kcc";
+    char *c = "kc";
+    return (a == b) * 10 + (a == c) + a[2];
+}
 
 // %=
 int assign_mod1() {
@@ -667,6 +835,38 @@ int postinc2() {
     return sum;
 }
 
+// 左辺のアドレスは一度だけ計算する
+int postinc3_g;
+int postinc3_idx() {
+    postinc3_g++;
+    return postinc3_g;
+}
+int postinc3() {
+    int a[5] = {0, 0, 0, 0, 0};
+    int i = 0;
+    a[i++] += 5;
+    a[i++]++;
+    ++a[i++];
+    a[postinc3_idx()] -= 2;
+    return a[0] * 1000 + a[1] * 100 + a[2] * 10 + i + postinc3_g;
+}
+int postinc4() {
+    char c = 127;
+    char d = c++;
+    short s = -32768;
+    s--;
+    long l = 10;
+    l <<= 2;
+    l |= 1;
+    int arr[3] = {10, 20, 30};
+    int *p = arr;
+    int x = *p++;
+    x += *++p;
+    p--;
+    int ci = c;
+    return (ci == -128) + (d == 127) * 2 + (s == 32767) * 4 + (l == 41) * 8 + (x == 40) * 16 + (*p == 20) * 32;
+}
+
 // predec
 int predec1() {
     int a;
@@ -804,6 +1004,8 @@ int main() {
     ASSERT(20, block3(), "bolck3");
 
     ASSERT(1, null_statement1(), "null_statement1");
+    ASSERT(112, dead_code1(), "dead_code1");
+    ASSERT(88, dead_code2(), "dead_code2");
 
     ASSERT(3, func_call1(), "func_call1");
     ASSERT(3, func_call2(), "func_call2");
@@ -813,6 +1015,7 @@ int main() {
     ASSERT(21, func_call6(), "func_call6");
     ASSERT(66, func_call7(), "func_call7");
     ASSERT(136, func_call8(), "func_call8");
+    ASSERT(43, func_call9(), "func_call9");
 
     ASSERT(2, func_define1(), "func_define1");
     ASSERT(5, func_define2(), "func_define2");
@@ -822,6 +1025,13 @@ int main() {
     ASSERT(15, func_define6(), "func_define6");
     ASSERT(8, func_define7(), "func_define7");
     ASSERT(55, func_define8(), "func_define8");
+    ASSERT(29, inline1(), "inline1");
+    ASSERT(45, inline2(), "inline2");
+    ASSERT(85, inline3(), "inline3");
+    ASSERT(0, tail_call1(), "tail_call1");
+    ASSERT(11, tail_call2(), "tail_call2");
+    ASSERT(77, tail_call3(), "tail_call3");
+    ASSERT(902, tail_call4(), "tail_call4");
 
     ASSERT(3, pointer1(), "pointer1");
     ASSERT(10, pointer2(), "pointer2");
@@ -851,6 +1061,8 @@ int main() {
     ASSERT(2, array3(), "array3");
     ASSERT(4, array4(), "array4");
     ASSERT(5, array5(), "array5");
+    ASSERT(43520, array6(3), "array6");
+    ASSERT(2742, array7(), "array7");
 
     ASSERT(30, mod1(), "mod1");
     ASSERT(1, mod2(), "mod2");
@@ -858,6 +1070,7 @@ int main() {
     ASSERT(3, char1(), "char1");
 
     ASSERT(0, string_literal1(), "string_literal");
+    ASSERT(109, string_literal2(), "string_literal2");
 
     ASSERT(2, assign_mod1(), "assign_mod1");
 
@@ -868,6 +1081,8 @@ int main() {
 
     ASSERT(0, postinc1(), "postinc1");
     ASSERT(45, postinc2(), "postinc2");
+    ASSERT(4914, postinc3(), "postinc3");
+    ASSERT(63, postinc4(), "postinc4");
     ASSERT(0, postdec1(), "postdec1");
     ASSERT(45, postdec2(), "postdec2");
 
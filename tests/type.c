@@ -132,6 +132,15 @@ int cast6() {
     return (c.m1 == 100) && (c.m2 == 200);
 }
 
+// 読みこんだ値は型の幅から符号拡張される
+int load_sign1() {
+    char c[2] = {-128, 127};
+    short s = -32768;
+    int i = -5;
+    char *p = c;
+    return (c[0] == -128) + (*p < 0) * 2 + (s == -32768) * 4 + (s < 0) * 8 + (i + 5 == 0) * 16 + (c[1] + c[0] == -1) * 32;
+}
+
 // 配列を戻り値とするのは未対応
 int main() {
     ASSERT(15, return_type_cast1(), "return_type_cast1");
@@ -158,6 +167,7 @@ int main() {
 
     ASSERT(1 << 14, short1(), "short1");
     ASSERT(127, short2(), "short2");
+    ASSERT(63, load_sign1(), "load_sign1");
 
     printf("ALL TEST OF type.c SUCCESS :)\n");
     return 0;
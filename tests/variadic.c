@@ -37,9 +37,27 @@ char *variadic2(char *fmt, ...) {
     return buf;
 }
 
+// 呼び出しをまたいで生きる変数が多く、-fomit-frame-pointerではrbpまで割り当てられる
+int many_live(int n) {
+    int a = n + 1, b = n + 2, c = n + 3, d = n + 4;
+    int e = n + 5, f = n + 6, g = n + 7, h = n + 8;
+    int r = 0;
+    if (n > 0) r = many_live(n - 1);
+    return r + a + b + c + d + e + f + g + h;
+}
+
+// 可変長引数の関数はrbpをフレームポインタとして使うので、呼び出し先でrbpが壊されると変数が読めなくなる
+int variadic3(int n, ...) {
+    int a = n, b = n * 2, c = n * 3, d = n * 4;
+    int e = n * 5, f = n * 6, g = n * 7, h = n * 8;
+    int r = many_live(n);
+    return r + a + b + c + d + e + f + g + h;
+}
+
 int main() {
     ASSERT(0, strcmp(variadic1("%d %d %s", 10, 20, "hello"), "10 20 hello"), "variadic1()");
     ASSERT(0, strcmp(variadic1("%d/%d/%s", 10000, -200, ""), "10000/-200/"), "variadic1()");
     ASSERT(0, strcmp(variadic2("%d %d %s", 10, 20, "hello"), "10 20 hello"), "variadic2()");
     ASSERT(0, strcmp(variadic2("%d/%d/%s", 10000, -200, ""), "10000/-200/"), "variadic2()");
+    ASSERT(204, variadic3(2), "variadic3()");
 }
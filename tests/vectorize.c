@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+
+int exit(int);
+int ASSERT(int expected, int actual, char *name) {
+    if (expected == actual)
+        return 0;
+
+    printf("name:<%s> failed!!\n", name);
+    printf("expected %d -> actual %d\n", expected, actual);
+    exit(1);
+}
+
+int g1[37];
+int g2[37];
+
+// 定数の代入 (余りの要素は元のループで処理する)
+int vectorize1() {
+    int a[23];
+    int i;
+    for (i = 0; i < 23; i++) {
+        a[i] = 7;
+    }
+    int sum = 0;
+    for (i = 0; i < 23; i++) sum = sum + a[i];
+    return sum + i;
+}
+
+// 要素ごとの演算と不変式
+int vectorize2(int k) {
+    int i;
+    for (i = 0; i < 37; i++) g1[i] = i;
+    for (i = 0; i < 37; i++) {
+        g2[i] = (g1[i] + k) ^ (g1[i] & 3) | 64;
+    }
+    int sum = 0;
+    for (i = 0; i < 37; i++) sum = sum + g2[i];
+    return sum;
+}
+
+// charの配列 (桁あふれは要素の大きさで切り捨てる)
+int vectorize3() {
+    char a[50];
+    char b[50];
+    for (int i = 0; i < 50; i++) {
+        a[i] = i * 5;
+        b[i] = 100;
+    }
+    for (int i = 0; i < 50; i++) {
+        a[i] = a[i] + b[i] - 3;
+    }
+    int sum = 0;
+    for (int i = 0; i < 50; i++) sum = sum + a[i];
+    return sum;
+}
+
+// shortの掛け算とlongの配列、定数によるシフト
+int vectorize4() {
+    short s[20];
+    short t[20];
+    long l[11];
+    long m[11];
+    for (int i = 0; i < 20; i++) t[i] = i - 5;
+    for (int i = 0; i < 11; i++) {
+        m[i] = i;
+        m[i] = m[i] * 1000000000;
+    }
+    for (int i = 0; i < 20; i++) s[i] = t[i] * t[i] * 3;
+    for (int i = 0; i < 11; i++) l[i] = (m[i] << 2) - m[i];
+    long sum = 0;
+    for (int i = 0; i < 20; i++) sum = sum + s[i];
+    for (int i = 0; i < 11; i++) sum = sum + l[i] / 1000000000;
+    return sum;
+}
+
+// 添字のずれ、i <= n、途中から始まるループ、複数の代入
+int vectorize5(int n) {
+    int a[40];
+    int b[40];
+    int c[40];
+    for (int i = 0; i < 40; i++) {
+        a[i] = i;
+        b[i] = 0;
+        c[i] = 0;
+    }
+    for (int i = 3; i <= n; i++) {
+        b[i] = a[i + 1] - a[i - 1];
+        c[i] = b[i] + a[i];
+    }
+    int sum = 0;
+    for (int i = 0; i < 40; i++) sum = sum + b[i] * 100 + c[i];
+    return sum;
+}
+
+// ループをまたぐ依存やポインターはベクトル化しない
+int vectorize6(int *p) {
+    int a[30];
+    a[0] = 1;
+    for (int i = 1; i < 30; i++) a[i] = a[i - 1] + 2;
+    for (int i = 0; i < 30; i++) p[i] = a[i];
+    for (int i = 1; i < 30; i++) p[i] = p[i] + p[i - 1];
+    return p[29];
+}
+
+int main() {
+    ASSERT(184, vectorize1(), "vectorize1");
+    ASSERT(3237, vectorize2(5), "vectorize2");
+    ASSERT(-33, vectorize3(), "vectorize3");
+    ASSERT(3375, vectorize4(), "vectorize4");
+    ASSERT(6118, vectorize5(30), "vectorize5(30)");
+    ASSERT(0, vectorize5(2), "vectorize5(2)");
+
+    int buf[30];
+    ASSERT(900, vectorize6(buf), "vectorize6");
+
+    printf("ALL TEST OF vectorize.c SUCCESS :)\n");
+    return 0;
+}
@@ -0,0 +1,280 @@
+.intel_syntax noprefix
+.section .rodata.str1.1,"aMS",@progbits,1
+.LC0:
+  .string "name:<%s> failed!!\n"
+.LC1:
+  .string "expected %d -> actual %d\n"
+.LC2:
+  .string "deep_even(10000001)"
+.LC3:
+  .string "deep_odd(10000001)"
+.LC4:
+  .string "deep_a(9000002, 0)"
+.LC5:
+  .string "ALL TEST OF deep/tail_call.c SUCCESS :)\n"
+.data
+.bss
+.text
+.globl ASSERT
+ASSERT:
+  sub rsp, 24
+  mov [rsp+0], rbx
+  mov [rsp+8], r12
+.L.tailcall.ASSERT:
+  movsxd rbx, edi
+  movsxd r12, esi
+  mov r10, rdx
+  cmp rbx, r12
+  jne .Lifend0000
+  mov rdi, 0
+  movsx rax, edi
+  jmp .L.return.ASSERT
+.Lifend0000:
+  lea rax, [rip+.LC0]
+  mov rdi, rax
+  mov rsi, r10
+  mov rax, 0
+  call printf
+  lea rax, [rip+.LC1]
+  mov rdi, rax
+  mov rsi, rbx
+  mov rdx, r12
+  mov rax, 0
+  call printf
+  mov rdi, 1
+  mov rax, 0
+  call exit
+.L.return.ASSERT:
+  mov rbx, [rsp+0]
+  mov r12, [rsp+8]
+  add rsp, 24
+  ret
+.globl deep_even
+deep_even:
+  sub rsp, 8
+.L.tailcall.deep_even:
+  movsxd r10, edi
+  test r10, r10
+  jne .Lifend0001
+  mov rdi, 1
+  movsx rax, edi
+  jmp .L.return.deep_even
+.Lifend0001:
+  lea rax, [r10-1]
+  mov rdi, rax
+  add rsp, 8
+  jmp deep_odd
+.L.return.deep_even:
+  add rsp, 8
+  ret
+.globl deep_odd
+deep_odd:
+  sub rsp, 8
+.L.tailcall.deep_odd:
+  movsxd r10, edi
+  test r10, r10
+  jne .Lifend0002
+  mov rdi, 0
+  movsx rax, edi
+  jmp .L.return.deep_odd
+.Lifend0002:
+  lea rax, [r10-1]
+  mov rdi, rax
+  add rsp, 8
+  jmp deep_even
+.L.return.deep_odd:
+  add rsp, 8
+  ret
+.globl deep_a
+deep_a:
+  sub rsp, 8
+.L.tailcall.deep_a:
+  movsxd r10, edi
+  movsxd r11, esi
+  test r10, r10
+  jne .Lifend0003
+  mov rax, r11
+  mov rdi, rax
+  movsx rax, edi
+  jmp .L.return.deep_a
+.Lifend0003:
+  mov rax, r10
+  mov rdi, rax
+  movsxd r10, edi
+  lea rax, [r10-1]
+  mov rdi, rax
+  movsxd r10, edi
+.Linlineend0001:
+  mov rax, r10
+  push rax
+  lea rax, [r11+1]
+  mov rsi, rax
+  pop rdi
+  add rsp, 8
+  jmp deep_b
+.L.return.deep_a:
+  add rsp, 8
+  ret
+.globl deep_b
+deep_b:
+  sub rsp, 8
+.L.tailcall.deep_b:
+  movsxd r10, edi
+  movsxd r11, esi
+  test r10, r10
+  jne .Lifend0004
+  mov rax, r11
+  mov rdi, rax
+  movsx rax, edi
+  jmp .L.return.deep_b
+.Lifend0004:
+  mov rax, r10
+  mov rdi, rax
+  movsxd r10, edi
+  lea rax, [r10-1]
+  mov rdi, rax
+  movsxd r10, edi
+.Linlineend0002:
+  mov rax, r10
+  push rax
+  lea rax, [r11+2]
+  mov rsi, rax
+  pop rdi
+  add rsp, 8
+  jmp deep_c
+.L.return.deep_b:
+  add rsp, 8
+  ret
+.globl deep_c
+deep_c:
+  sub rsp, 8
+.L.tailcall.deep_c:
+  movsxd r10, edi
+  movsxd r11, esi
+  test r10, r10
+  jne .Lifend0005
+  mov rax, r11
+  mov rcx, rax
+  mov rdi, 2361183241434822607
+  imul rdi
+  sar rdx, 7
+  mov rax, rdx
+  shr rax, 63
+  add rax, rdx
+  imul rax, rax, 1000
+  sub rcx, rax
+  mov rax, rcx
+  mov rdi, rax
+  movsx rax, edi
+  jmp .L.return.deep_c
+.Lifend0005:
+  mov rax, r10
+  mov rdi, rax
+  movsxd r10, edi
+  lea rax, [r10-1]
+  mov rdi, rax
+  movsxd r10, edi
+.Linlineend0003:
+  mov rax, r10
+  push rax
+  lea rax, [r11+3]
+  mov rcx, rax
+  mov rdi, 2361183241434822607
+  imul rdi
+  sar rdx, 7
+  mov rax, rdx
+  shr rax, 63
+  add rax, rdx
+  imul rax, rax, 1000
+  sub rcx, rax
+  mov rax, rcx
+  mov rsi, rax
+  pop rdi
+  add rsp, 8
+  jmp deep_a
+.L.return.deep_c:
+  add rsp, 8
+  ret
+.globl main
+main:
+  sub rsp, 24
+  mov [rsp+0], rbx
+.L.tailcall.main:
+  mov r10, 10000001
+  test r10, r10
+  jne .Lifend0006
+  mov rbx, 1
+  jmp .Linlineend0004
+.Lifend0006:
+  lea rax, [r10-1]
+  mov rdi, rax
+  call deep_odd
+  mov rdi, rax
+  movsxd rbx, edi
+.Linlineend0004:
+  mov rax, rbx
+  mov rsi, rax
+  mov rdi, 0
+  lea rax, [rip+.LC2]
+  mov rdx, rax
+  call ASSERT
+  mov r10, 10000001
+  test r10, r10
+  jne .Lifend0007
+  mov rbx, 0
+  jmp .Linlineend0005
+.Lifend0007:
+  lea rax, [r10-1]
+  mov rdi, rax
+  call deep_even
+  mov rdi, rax
+  movsxd rbx, edi
+.Linlineend0005:
+  mov rax, rbx
+  mov rsi, rax
+  mov rdi, 1
+  lea rax, [rip+.LC3]
+  mov rdx, rax
+  call ASSERT
+  mov r10, 9000002
+  mov r11, 0
+  test r10, r10
+  jne .Lifend0008
+  mov rax, r11
+  mov rdi, rax
+  movsxd rbx, edi
+  jmp .Linlineend0006
+.Lifend0008:
+  mov rax, r10
+  mov rdi, rax
+  movsxd r10, edi
+  lea rax, [r10-1]
+  mov rdi, rax
+  movsxd r10, edi
+.Linlineend0007:
+  mov rax, r10
+  push rax
+  lea rax, [r11+1]
+  mov rsi, rax
+  pop rdi
+  call deep_b
+  mov rdi, rax
+  movsxd rbx, edi
+.Linlineend0006:
+  mov rax, rbx
+  mov rsi, rax
+  mov rdi, 3
+  lea rax, [rip+.LC4]
+  mov rdx, rax
+  call ASSERT
+  lea rax, [rip+.LC5]
+  mov rdi, rax
+  mov rax, 0
+  call printf
+  mov rax, 0
+  mov rdi, rax
+  movsx rax, edi
+.L.return.main:
+  mov rbx, [rsp+0]
+  add rsp, 24
+  ret